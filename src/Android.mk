@@ -8,7 +8,8 @@ LOCAL_SRC_FILES :=  workorder.c strand.c execute.c flowops_library.c \
         flowops.c common.c main.c slave.c  stats.c handshake.c parse.c shm.c \
         master.c print.c signals.c goodbye.c delay.c rate.c sendfilev.c \
         logging.c netstat.c numbers.c sync.c protocol.c tcp.c generic.c \
-        udp.c
+        affinity.c async.c baseline.c batch.c bufpool.c dist.c replay.c touch.c \
+        udp.c verify.c compute.c
 
 LOCAL_CFLAGS := -DHAVE_CONFIG_H
 LOCAL_C_INCLUDES := $(LOCAL_PATH)/..
@@ -0,0 +1,383 @@
+/*
+ * Copyright (C) 2008 Sun Microsystems
+ *
+ * This file is part of uperf.
+ *
+ * uperf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3
+ * as published by the Free Software Foundation.
+ *
+ * uperf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with uperf.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/*
+ * CPU and NUMA placement of strands. A group's cpus= (master) and
+ * slavecpus= (slave) are lists like "0-3,8,node1", where nodeN stands
+ * for the CPUs of NUMA node N on the host that runs the strand. With
+ * placement=rr or compact every strand gets a CPU of its own, taking
+ * the nodes in turn or filling them one after the other. A strand whose
+ * CPUs are all on one node also prefers that node for its memory: its
+ * buffers, and the pages of the shared memory that hold its state.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif /* HAVE_STRING_H */
+#include <strings.h>
+#ifdef HAVE_SCHED_SETAFFINITY
+#include <sched.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+#endif /* HAVE_SCHED_SETAFFINITY */
+
+#include "uperf.h"
+#include "main.h"
+#include "logging.h"
+#include "workorder.h"
+#include "stats.h"
+#include "strand.h"
+#include "shm.h"
+#include "print.h"
+#include "affinity.h"
+
+extern options_t options;
+
+#define	SYS_NODE	"/sys/devices/system/node"
+#define	LONG_BITS	(8 * sizeof (unsigned long))
+
+#ifndef	MPOL_PREFERRED
+#define	MPOL_PREFERRED	1
+#endif
+#ifndef	MPOL_MF_MOVE
+#define	MPOL_MF_MOVE	(1 << 1)
+#endif
+
+/*
+ * Parse one item of a CPU list: "3", "0-7" or "node1". Returns 0, or
+ * -1 if it is not valid.
+ */
+static int
+cpulist_item(char *item, int *node, int *lo, int *hi)
+{
+	char *end;
+
+	*node = -1;
+	if (strncmp(item, "node", 4) == 0) {
+		if (!isdigit(item[4]))
+			return (-1);
+		*node = strtol(item + 4, &end, 10);
+		return (*end == '\0' ? 0 : -1);
+	}
+	if (!isdigit(*item))
+		return (-1);
+	*lo = *hi = strtol(item, &end, 10);
+	if (*end == '-') {
+		if (!isdigit(end[1]))
+			return (-1);
+		*hi = strtol(end + 1, &end, 10);
+	}
+	if (*end != '\0' && *end != '\n')
+		return (-1);
+
+	return (*lo <= *hi && *hi < STRAND_MAX_CPUS ? 0 : -1);
+}
+
+/* Syntax of a cpus= list, checked by the master for all the hosts */
+int
+cpulist_check(char *list)
+{
+	char buf[GROUP_CPULIST_LEN];
+	char *item, *last;
+	int node, lo, hi;
+
+	if (*list == '\0' || strlen(list) >= sizeof (buf))
+		return (-1);
+	(void) strlcpy(buf, list, sizeof (buf));
+	for (item = strtok_r(buf, ",", &last); item;
+	    item = strtok_r(NULL, ",", &last)) {
+		if (cpulist_item(item, &node, &lo, &hi) != 0)
+			return (-1);
+	}
+
+	return (0);
+}
+
+#ifdef HAVE_SCHED_SETAFFINITY
+
+/* NUMA node of every CPU of this host; 0 if there is no NUMA info */
+static void
+cpu_nodes(int *node)
+{
+	char path[PATH_MAX];
+	char buf[4096];
+	struct dirent *d;
+	DIR *dir;
+	FILE *fp;
+	char *item, *last;
+	int nd, lo, hi, cpu, unused;
+
+	bzero(node, STRAND_MAX_CPUS * sizeof (int));
+	if ((dir = opendir(SYS_NODE)) == NULL)
+		return;
+	while ((d = readdir(dir)) != NULL) {
+		if (strncmp(d->d_name, "node", 4) != 0 ||
+		    !isdigit(d->d_name[4]))
+			continue;
+		nd = atoi(d->d_name + 4);
+		(void) snprintf(path, sizeof (path), SYS_NODE "/%s/cpulist",
+		    d->d_name);
+		if ((fp = fopen(path, "r")) == NULL)
+			continue;
+		if (fgets(buf, sizeof (buf), fp) != NULL) {
+			for (item = strtok_r(buf, ",", &last); item;
+			    item = strtok_r(NULL, ",", &last)) {
+				if (cpulist_item(item, &unused, &lo,
+				    &hi) != 0)
+					continue;
+				for (cpu = lo; cpu <= hi; cpu++)
+					node[cpu] = nd;
+			}
+		}
+		(void) fclose(fp);
+	}
+	(void) closedir(dir);
+}
+
+static int
+cpulist_parse(char *list, int *node, cpu_set_t *set)
+{
+	char buf[GROUP_CPULIST_LEN];
+	char *item, *last;
+	int nd, lo, hi, cpu;
+
+	CPU_ZERO(set);
+	(void) strlcpy(buf, list, sizeof (buf));
+	for (item = strtok_r(buf, ",", &last); item;
+	    item = strtok_r(NULL, ",", &last)) {
+		if (cpulist_item(item, &nd, &lo, &hi) != 0)
+			return (-1);
+		if (nd >= 0) {
+			for (cpu = 0; cpu < STRAND_MAX_CPUS; cpu++)
+				if (node[cpu] == nd)
+					CPU_SET(cpu, set);
+		} else {
+			for (cpu = lo; cpu <= hi; cpu++)
+				CPU_SET(cpu, set);
+		}
+	}
+
+	return (0);
+}
+
+/*
+ * The CPUs of set in the order strands take them: ascending for
+ * compact, and for rr the first CPU of every node, then the second
+ * one of every node, and so on.
+ */
+static int
+cpu_order(cpu_set_t *set, int *node, int placement, int *order)
+{
+	int cpus[STRAND_MAX_CPUS];
+	int rank[STRAND_MAX_CPUS];
+	int seen[STRAND_MAX_CPUS];
+	int ncpus = 0;
+	int n = 0;
+	int cpu, i, r;
+
+	for (cpu = 0; cpu < STRAND_MAX_CPUS; cpu++)
+		if (CPU_ISSET(cpu, set))
+			cpus[ncpus++] = cpu;
+	if (placement != GROUP_PLACE_RR) {
+		(void) memcpy(order, cpus, ncpus * sizeof (int));
+		return (ncpus);
+	}
+
+	bzero(seen, sizeof (seen));
+	for (i = 0; i < ncpus; i++)
+		rank[i] = seen[node[cpus[i]]]++;
+	for (r = 0; n < ncpus; r++)
+		for (i = 0; i < ncpus; i++)
+			if (rank[i] == r)
+				order[n++] = cpus[i];
+
+	return (n);
+}
+
+/* Make node the preferred one for the memory of s */
+static void
+strand_prefer_node(strand_t *s, int node)
+{
+#if defined(SYS_set_mempolicy) && defined(SYS_mbind)
+	unsigned long mask[STRAND_MAX_CPUS / LONG_BITS];
+	uintptr_t page = sysconf(_SC_PAGESIZE);
+	uintptr_t start, end;
+	unsigned long nbits = 8 * sizeof (mask);
+
+	bzero(mask, sizeof (mask));
+	mask[node / LONG_BITS] |= 1UL << (node % LONG_BITS);
+	if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, nbits) != 0)
+		uperf_info("set_mempolicy: %s\n", strerror(errno));
+	/* Only the pages that hold nothing but the strand itself */
+	start = ((uintptr_t)s + page - 1) & ~(page - 1);
+	end = ((uintptr_t)(s + 1)) & ~(page - 1);
+	if (end > start && syscall(SYS_mbind, start, end - start,
+	    MPOL_PREFERRED, mask, nbits, MPOL_MF_MOVE) != 0)
+		uperf_info("mbind: %s\n", strerror(errno));
+#endif
+}
+
+/*
+ * Bind the calling strand as its group asks. Returns UPERF_FAILURE if
+ * none of the CPUs asked for is available.
+ */
+int
+strand_bind(strand_t *s)
+{
+	int node[STRAND_MAX_CPUS];
+	int order[STRAND_MAX_CPUS];
+	group_t *g = s->worklist;
+	char *list = (s->role == MASTER) ? g->cpus : g->slave_cpus;
+	cpu_set_t avail, set;
+	int n, cpu, nd;
+
+	bzero(s->bound, sizeof (s->bound));
+	if (*list == '\0' && g->placement == GROUP_PLACE_ANY)
+		return (UPERF_SUCCESS);
+	cpu_nodes(node);
+	if (sched_getaffinity(0, sizeof (avail), &avail) != 0) {
+		uperf_error("sched_getaffinity: %s\n", strerror(errno));
+		return (UPERF_FAILURE);
+	}
+	if (*list == '\0') {
+		set = avail;
+	} else {
+		if (cpulist_parse(list, node, &set) != 0) {
+			uperf_error("%s: invalid CPU list %s\n", g->name,
+			    list);
+			return (UPERF_FAILURE);
+		}
+		CPU_AND(&set, &set, &avail);
+	}
+	if (CPU_COUNT(&set) == 0) {
+		uperf_error("%s: none of CPUs %s are available\n", g->name,
+		    list);
+		return (UPERF_FAILURE);
+	}
+	if (g->placement != GROUP_PLACE_ANY) {
+		n = cpu_order(&set, node, g->placement, order);
+		CPU_ZERO(&set);
+		/* sid counts from 0 in every group, not across them */
+		CPU_SET(order[s->sid % n], &set);
+	}
+	if (sched_setaffinity(0, sizeof (set), &set) != 0) {
+		uperf_error("sched_setaffinity: %s\n", strerror(errno));
+		return (UPERF_FAILURE);
+	}
+
+	nd = -1;
+	for (cpu = 0; cpu < STRAND_MAX_CPUS; cpu++) {
+		if (!CPU_ISSET(cpu, &set))
+			continue;
+		STRAND_CPU_SET(s->bound, cpu);
+		if (nd == -1)
+			nd = node[cpu];
+		else if (nd != node[cpu])
+			nd = -2;
+	}
+	if (nd >= 0)
+		strand_prefer_node(s, nd);
+
+	return (UPERF_SUCCESS);
+}
+
+#else
+
+int
+strand_bind(strand_t *s)
+{
+	group_t *g = s->worklist;
+
+	bzero(s->bound, sizeof (s->bound));
+	if (g->cpus[0] != '\0' || g->slave_cpus[0] != '\0' ||
+	    g->placement != GROUP_PLACE_ANY)
+		uperf_warn("%s: CPU binding is not supported here\n", g->name);
+
+	return (UPERF_SUCCESS);
+}
+
+#endif /* HAVE_SCHED_SETAFFINITY */
+
+/* Note the CPU the strand runs on right now */
+void
+strand_cpu_sample(strand_t *s)
+{
+#ifdef HAVE_SCHED_GETCPU
+	int cpu = sched_getcpu();
+
+	if (cpu >= 0 && cpu < STRAND_MAX_CPUS)
+		STRAND_CPU_SET(s->ran_on, cpu);
+#endif /* HAVE_SCHED_GETCPU */
+}
+
+/* "0-3,8", or "-" for none */
+static char *
+cpumask_print(uint64_t *mask, char *buf, int len)
+{
+	int cpu, lo;
+	int n = 0;
+
+	buf[0] = '\0';
+	for (cpu = 0; cpu < STRAND_MAX_CPUS && n < len; cpu++) {
+		if (!STRAND_CPU_ISSET(mask, cpu))
+			continue;
+		for (lo = cpu; cpu + 1 < STRAND_MAX_CPUS &&
+		    STRAND_CPU_ISSET(mask, cpu + 1); cpu++)
+			;
+		if (lo == cpu)
+			n += snprintf(buf + n, len - n, "%s%d", n ? "," : "",
+			    cpu);
+		else
+			n += snprintf(buf + n, len - n, "%s%d-%d",
+			    n ? "," : "", lo, cpu);
+	}
+	if (buf[0] == '\0')
+		(void) strlcpy(buf, "-", len);
+
+	return (buf);
+}
+
+/* Where every strand was bound and where it actually ran */
+void
+print_strand_cpus(uperf_shm_t *shm)
+{
+	char bound[64], ran[64];
+	char name[UPERF_NAME_LEN];
+	strand_t *s;
+	int i;
+
+	printf("\n%-15s %-24s %s\n", "Strand CPUs", "bound", "ran on");
+	uperf_line();
+	for (i = 0; i < shm->no_strands; i++) {
+		s = shm_get_strand(shm, i);
+		(void) snprintf(name, sizeof (name), "Thr%d", i);
+		printf("%-15s %-24s %s\n", name,
+		    cpumask_print(s->bound, bound, sizeof (bound)),
+		    cpumask_print(s->ran_on, ran, sizeof (ran)));
+	}
+	printf("\n");
+}
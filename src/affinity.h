@@ -0,0 +1,26 @@
+/* Copyright (C) 2008 Sun Microsystems
+ *
+ * This file is part of uperf.
+ *
+ * uperf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3
+ * as published by the Free Software Foundation.
+ *
+ * uperf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with uperf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _AFFINITY_H
+#define	_AFFINITY_H
+
+int cpulist_check(char *);
+int strand_bind(strand_t *);
+void strand_cpu_sample(strand_t *);
+void print_strand_cpus(uperf_shm_t *);
+
+#endif /* _AFFINITY_H */
@@ -0,0 +1,363 @@
+/*
+ * Copyright (C) 2008 Sun Microsystems
+ *
+ * This file is part of uperf.
+ *
+ * uperf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3
+ * as published by the Free Software Foundation.
+ *
+ * uperf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with uperf.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/*
+ * Event driven strands. A group with nconns=N opens N connections
+ * per strand: transactions that set up or tear down connections are
+ * simply run N times, while transactions made up of read/write
+ * flowops are multiplexed over all of the strand's TCP connections
+ * with epoll. Every connection keeps its own cursor into the
+ * transaction, so a handful of strands can drive tens of thousands
+ * of clients.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif /* HAVE_SYS_EPOLL_H */
+
+#include "uperf.h"
+#include "protocol.h"
+#include "logging.h"
+#include "main.h"
+#include "flowops.h"
+#include "workorder.h"
+#include "stats.h"
+#include "strand.h"
+#include "shm.h"
+#include "async.h"
+
+extern options_t options;
+
+#define	ASYNC_EVENTS	256	/* events per epoll_wait */
+#define	ASYNC_WAIT	100	/* ms; bounds the time to notice a signal */
+
+#define	ASYNC_PENDING	0	/* waiting for the socket */
+#define	ASYNC_DONE	1	/* all iterations completed */
+#define	ASYNC_EOF	2	/* peer closed the connection */
+
+typedef int (*async_io_func)(protocol_t *, void *, int, void *);
+
+typedef struct async_conn {
+	protocol_t	*p;
+	flowop_t	*f;		/* Current flowop */
+	uint64_t	rep;		/* Repetitions of f done (count=) */
+	uint64_t	iter;		/* Passes over the txn done */
+	int		done;		/* Bytes of the current op moved */
+	int		flags;		/* fd flags to restore */
+	uint32_t	events;		/* Events registered with epoll */
+	hrtime_t	start;		/* Start of the current op */
+} async_conn_t;
+
+/*
+ * Each connection needs an fd, so make sure we are not held back by
+ * the soft limit.
+ */
+int
+async_group_init(group_t *g)
+{
+	struct rlimit rl;
+	rlim_t want;
+
+	/* group_max_open_connections() counts the nconns already */
+	want = (rlim_t)g->nthreads * group_max_open_connections(g) + 64;
+	if (getrlimit(RLIMIT_NOFILE, &rl) != 0 || rl.rlim_cur >= want)
+		return (UPERF_SUCCESS);
+	rl.rlim_cur = (rl.rlim_max == RLIM_INFINITY || rl.rlim_max > want) ?
+	    want : rl.rlim_max;
+	if (setrlimit(RLIMIT_NOFILE, &rl) != 0 || rl.rlim_cur < want)
+		uperf_warn("nconns=%u needs %lu fds, limited to %lu\n",
+		    g->max_async, (unsigned long)want,
+		    (unsigned long)rl.rlim_cur);
+
+	return (UPERF_SUCCESS);
+}
+
+/* Can txn be multiplexed, i.e. does it only move data? */
+int
+async_txn(txn_t *txn)
+{
+	flowop_t *f;
+
+	for (f = txn->flist; f; f = f->next) {
+		if (f->type != FLOWOP_READ && f->type != FLOWOP_WRITE &&
+		    f->type != FLOWOP_SEND && f->type != FLOWOP_RECV)
+			return (0);
+	}
+
+	return (txn->flist != NULL);
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+static async_io_func
+async_func(protocol_t *p, flowop_t *f)
+{
+	switch (f->type) {
+	case FLOWOP_READ:
+		return (p->read);
+	case FLOWOP_WRITE:
+		return (p->write);
+	case FLOWOP_SEND:
+		return (p->send);
+	default:
+		return (p->recv);
+	}
+}
+
+static uint32_t
+async_want(flowop_t *f)
+{
+	if (f->type == FLOWOP_WRITE || f->type == FLOWOP_SEND)
+		return (EPOLLOUT);
+	return (EPOLLIN);
+}
+
+/* One op completed. Record its latency and move the cursor */
+static int
+async_advance(strand_t *s, txn_t *txn, async_conn_t *c, uint64_t iter)
+{
+	newstats_t *ns = FLOWOP_STAT(c->f);
+
+	STATS_RECORD_FLOWOP(FLOWOP_BEGIN, s, ns, 0, 0);
+	if (ns != NULL)
+		ns->time_used_start = c->start;
+	STATS_RECORD_FLOWOP(FLOWOP_END, s, ns, c->f->options.size, 1);
+
+	c->done = 0;
+	c->start = GETHRTIME();
+	if (++c->rep < c->f->options.count)
+		return (ASYNC_PENDING);
+	c->rep = 0;
+	if ((c->f = c->f->next) != NULL)
+		return (ASYNC_PENDING);
+	c->f = txn->flist;
+	if (iter > 0 && ++c->iter >= iter)
+		return (ASYNC_DONE);
+
+	return (ASYNC_PENDING);
+}
+
+/* Make sure epoll reports the event c's current flowop waits for */
+static int
+async_arm(int epfd, async_conn_t *c)
+{
+	struct epoll_event ev;
+
+	if (c->events == async_want(c->f))
+		return (0);
+	c->events = ev.events = async_want(c->f);
+	ev.data.ptr = c;
+	if (epoll_ctl(epfd, EPOLL_CTL_MOD, c->p->fd, &ev) != 0) {
+		ulog_err("epoll_ctl");
+		return (-1);
+	}
+
+	return (0);
+}
+
+/*
+ * Move as much data on c as the socket allows. Returns one of
+ * ASYNC_PENDING, ASYNC_DONE, ASYNC_EOF, or -1 on error.
+ */
+static int
+async_progress(strand_t *s, txn_t *txn, int epfd, async_conn_t *c,
+    uint64_t iter)
+{
+	uint64_t calls;
+	uint32_t was;
+	int size;
+	int ret;
+	int n;
+
+	for (;;) {
+		size = c->f->options.size;
+		calls = c->p->syscalls;
+		n = async_func(c->p, c->f)(c->p, s->buffer + c->done,
+		    size - c->done, NULL);
+		if (c->f->stats != NULL &&
+		    stats_measured(FLOWOP_BEGIN, s, NULL))
+			c->f->stats->syscalls += c->p->syscalls - calls;
+		if (n > 0) {
+			if ((c->done += n) < size)
+				continue;
+			was = async_want(c->f);
+			if ((ret = async_advance(s, txn, c, iter))
+			    != ASYNC_PENDING)
+				return (ret);
+			/*
+			 * A reply cannot have arrived yet if we were
+			 * just writing; wait for it instead of burning
+			 * a read on EAGAIN.
+			 */
+			if (was == EPOLLOUT && async_want(c->f) == EPOLLIN)
+				return (async_arm(epfd, c) == 0 ?
+				    ASYNC_PENDING : -1);
+			continue;
+		}
+		if (n == 0 || PEER_RESET(s))
+			return (ASYNC_EOF);
+		if (errno == EINTR)
+			continue;
+		if (errno != EAGAIN && errno != EWOULDBLOCK) {
+			ulog_err("Error for flowop %s", c->f->name);
+			return (-1);
+		}
+		return (async_arm(epfd, c) == 0 ? ASYNC_PENDING : -1);
+	}
+}
+
+static void
+async_release(int epfd, async_conn_t *c)
+{
+	if (c->events != 0)
+		(void) epoll_ctl(epfd, EPOLL_CTL_DEL, c->p->fd, NULL);
+	c->events = 0;
+	(void) fcntl(c->p->fd, F_SETFL, c->flags);
+}
+
+/* How long to wait for events: not past the end of the duration */
+static int
+async_wait(strand_t *s)
+{
+	hrtime_t now;
+
+	if (s->deadline == 0)
+		return (ASYNC_WAIT);
+	now = GETHRTIME();
+	if (now >= s->deadline)
+		return (0);
+
+	return (MIN(ASYNC_WAIT, (s->deadline - now + 999999) / 1000000));
+}
+
+/*
+ * Run txn on all of s's connections at once. Each connection makes
+ * iter passes over the txn; iter == 0 runs until the strand is
+ * signalled (duration).
+ *
+ * Returns one of UPERF_SUCCESS, UPERF_FAILURE, UPERF_DURATION_EXPIRED
+ */
+int
+async_txn_execute(strand_t *s, txn_t *txn, uint64_t iter)
+{
+	struct epoll_event events[ASYNC_EVENTS];
+	struct epoll_event ev;
+	async_conn_t *conns;
+	async_conn_t *c;
+	protocol_t *p;
+	int nconns = 0;
+	int active = 0;
+	int expired = 0;
+	int error = UPERF_SUCCESS;
+	int epfd;
+	int ret;
+	int i, n;
+
+	for (p = s->cpool; p; p = p->next)
+		if (p->p_id == txn->flist->p_id)
+			nconns++;
+	if (nconns == 0) {
+		uperf_log_msg(UPERF_LOG_ERROR, 0, "No connections to drive");
+		return (UPERF_FAILURE);
+	}
+	if ((conns = calloc(nconns, sizeof (async_conn_t))) == NULL) {
+		ulog_err("calloc");
+		return (UPERF_FAILURE);
+	}
+	if ((epfd = epoll_create1(0)) < 0) {
+		ulog_err("epoll_create1");
+		free(conns);
+		return (UPERF_FAILURE);
+	}
+
+	c = conns;
+	for (p = s->cpool; p; p = p->next) {
+		if (p->p_id != txn->flist->p_id)
+			continue;
+		c->p = p;
+		c->f = txn->flist;
+		c->start = GETHRTIME();
+		c->flags = fcntl(p->fd, F_GETFL);
+		(void) fcntl(p->fd, F_SETFL, c->flags | O_NONBLOCK);
+		c->events = ev.events = async_want(c->f);
+		ev.data.ptr = c;
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, p->fd, &ev) != 0) {
+			ulog_err("epoll_ctl");
+			c->events = 0;
+			c++;
+			error = UPERF_FAILURE;
+			break;
+		}
+		active++;
+		c++;
+	}
+
+	while (active > 0 && error == UPERF_SUCCESS && !SIGNALLED(s)) {
+		n = epoll_wait(epfd, events, ASYNC_EVENTS, async_wait(s));
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			ulog_err("epoll_wait");
+			error = UPERF_FAILURE;
+			break;
+		}
+		for (i = 0; i < n; i++) {
+			c = events[i].data.ptr;
+			ret = async_progress(s, txn, epfd, c, iter);
+			if (ret == ASYNC_PENDING)
+				continue;
+			if (ret < 0) {
+				error = UPERF_FAILURE;
+				break;
+			}
+			/* A hangup means the peer's duration expired */
+			if (ret == ASYNC_EOF)
+				expired = 1;
+			async_release(epfd, c);
+			active--;
+		}
+	}
+	if (error == UPERF_SUCCESS && (active > 0 || expired))
+		error = UPERF_DURATION_EXPIRED;
+
+	for (c = conns; c < conns + nconns && c->p != NULL; c++)
+		async_release(epfd, c);
+	(void) close(epfd);
+	free(conns);
+
+	return (error);
+}
+#else
+/* ARGSUSED */
+int
+async_txn_execute(strand_t *s, txn_t *txn, uint64_t iter)
+{
+	uperf_log_msg(UPERF_LOG_ERROR, 0, "nconns requires epoll");
+	return (UPERF_FAILURE);
+}
+#endif /* HAVE_SYS_EPOLL_H */
@@ -0,0 +1,28 @@
+/* Copyright (C) 2008 Sun Microsystems
+ *
+ * This file is part of uperf.
+ *
+ * uperf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3
+ * as published by the Free Software Foundation.
+ *
+ * uperf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with uperf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ASYNC_H
+#define	_ASYNC_H
+
+/* Does group g run max_async connections per strand? */
+#define	GROUP_IS_ASYNC(g)	((g)->max_async > 0)
+
+int async_group_init(group_t *);
+int async_txn(txn_t *);
+int async_txn_execute(strand_t *, txn_t *, uint64_t);
+
+#endif /* _ASYNC_H */
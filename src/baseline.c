@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2008 Sun Microsystems
+ *
+ * This file is part of uperf.
+ *
+ * uperf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3
+ * as published by the Free Software Foundation.
+ *
+ * uperf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with uperf.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/*
+ * Baselines (-B). The first run with -B <file> stores its results in
+ * file, one metric per line:
+ *
+ *	<name> <value> <stddev> <n>
+ *
+ * Later runs compare themselves against it. Names end in .thru (b/s)
+ * and .ops (ops/s), where more is better, or in .p50/.p99 (nsecs),
+ * where less is. stddev and n come from the batches of -b. A metric
+ * regresses when it is more than options.regress_pct percent worse
+ * than the baseline and Welch's t-test finds the change significant
+ * at 95%. One sample (n 1: no -b, or a flowop outside duration txns
+ * such as connect) says nothing about noise, so such a metric is
+ * reported but never regresses.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <errno.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif /* HAVE_STRING_H */
+#include <strings.h>
+
+#include "uperf.h"
+#include "main.h"
+#include "logging.h"
+#include "workorder.h"
+#include "stats.h"
+#include "strand.h"
+#include "shm.h"
+#include "numbers.h"
+#include "print.h"
+#include "batch.h"
+#include "baseline.h"
+
+extern options_t options;
+
+#define	BASELINE_NAMELEN	128
+#define	BASELINE_LINE		256
+
+typedef struct baseline_metric {
+	char	name[BASELINE_NAMELEN];
+	double	value;
+	double	stddev;
+	int	n;
+} baseline_metric_t;
+
+typedef struct baseline {
+	int			count;
+	int			size;
+	baseline_metric_t	*m;
+} baseline_t;
+
+/* Does a larger value mean better performance? */
+static int
+more_is_better(char *name)
+{
+	char *dot = strrchr(name, '.');
+
+	return (dot != NULL &&
+	    (strcmp(dot, ".thru") == 0 || strcmp(dot, ".ops") == 0));
+}
+
+static int
+baseline_add(baseline_t *b, char *name, double value, double stddev, int n)
+{
+	baseline_metric_t *m;
+
+	if (b->count == b->size) {
+		b->size = b->size ? 2 * b->size : 64;
+		m = realloc(b->m, b->size * sizeof (baseline_metric_t));
+		if (m == NULL)
+			return (UPERF_FAILURE);
+		b->m = m;
+	}
+	m = &b->m[b->count++];
+	(void) strlcpy(m->name, name, sizeof (m->name));
+	m->value = value;
+	m->stddev = stddev;
+	m->n = n;
+
+	return (UPERF_SUCCESS);
+}
+
+static baseline_metric_t *
+baseline_find(baseline_t *b, char *name)
+{
+	int i;
+
+	for (i = 0; i < b->count; i++)
+		if (strcmp(b->m[i].name, name) == 0)
+			return (&b->m[i]);
+
+	return (NULL);
+}
+
+/* The metrics of this run */
+static int
+baseline_collect(uperf_shm_t *shm, baseline_t *b)
+{
+	workorder_t *w = shm->workorder;
+	newstats_t *agg = AGG_STAT(shm);
+	batch_summary_t bs, p50, p99;
+	char name[BASELINE_NAMELEN];
+	newstats_t ns;
+	double secs;
+	txn_t *txn;
+	flowop_t *f;
+	int err = 0;
+	int i;
+
+	if ((secs = (agg->end_time - agg->start_time) / 1.0e+9) > 0) {
+		err |= baseline_add(b, "total.thru", agg->size * 8.0 / secs,
+		    0, 1);
+		err |= baseline_add(b, "total.ops", agg->count / secs, 0, 1);
+	}
+	for (i = 0; i < workorder_max_txn(w); i++) {
+		if (batch_txn_summary(i, &bs) == 0)
+			continue;
+		(void) snprintf(name, sizeof (name), "txn%d.thru", i + 1);
+		err |= baseline_add(b, name, bs.mean, bs.stddev, bs.n);
+	}
+	for (i = 0; i < w->ngrp; i++) {
+		for (txn = w->grp[i].tlist; txn; txn = txn->next) {
+			for (f = txn->flist; f; f = f->next) {
+				int len;
+
+				flowop_stats(shm, i, txn, f, &ns);
+				if (ns.count == 0)
+					continue;
+				len = snprintf(name, sizeof (name),
+				    "g%d.txn%d.f%d.%s", i + 1, TXN_ID(txn) + 1,
+				    FLOWOP_ID(f) + 1, f->name);
+				if (len >= sizeof (name) - 8)
+					continue;
+				secs = (ns.end_time - ns.start_time) / 1.0e+9;
+				if (secs > 0 && ns.size > 0) {
+					(void) strcpy(name + len, ".thru");
+					err |= baseline_add(b, name,
+					    ns.size * 8.0 / secs, 0, 1);
+				}
+				if (secs > 0) {
+					(void) strcpy(name + len, ".ops");
+					err |= baseline_add(b, name,
+					    ns.count / secs, 0, 1);
+				}
+				if (batch_flowop_summary(i, txn, f, &p50,
+				    &p99) == 0) {
+					bzero(&p50, sizeof (p50));
+					bzero(&p99, sizeof (p99));
+					p50.n = p99.n = 1;
+					p50.mean = stats_percentile(&ns, 50.0);
+					p99.mean = stats_percentile(&ns, 99.0);
+				}
+				(void) strcpy(name + len, ".p50");
+				err |= baseline_add(b, name, p50.mean,
+				    p50.stddev, p50.n);
+				(void) strcpy(name + len, ".p99");
+				err |= baseline_add(b, name, p99.mean,
+				    p99.stddev, p99.n);
+			}
+		}
+	}
+
+	return (err ? UPERF_FAILURE : UPERF_SUCCESS);
+}
+
+static int
+baseline_write(baseline_t *b, char *file)
+{
+	FILE *fp;
+	int i;
+
+	if ((fp = fopen(file, "w")) == NULL) {
+		uperf_error("Cannot create baseline %s: %s\n", file,
+		    strerror(errno));
+		return (UPERF_FAILURE);
+	}
+	fprintf(fp, "# uperf %s baseline of %s\n", UPERF_VERSION,
+	    options.app_profile_name);
+	fprintf(fp, "# <name> <value> <stddev> <n>\n");
+	for (i = 0; i < b->count; i++)
+		fprintf(fp, "%s %.6e %.6e %d\n", b->m[i].name, b->m[i].value,
+		    b->m[i].stddev, b->m[i].n);
+	if (fclose(fp) != 0) {
+		uperf_error("Cannot write baseline %s: %s\n", file,
+		    strerror(errno));
+		return (UPERF_FAILURE);
+	}
+
+	return (UPERF_SUCCESS);
+}
+
+static int
+baseline_read(baseline_t *b, FILE *fp, char *file)
+{
+	char line[BASELINE_LINE];
+	char name[BASELINE_NAMELEN];
+	double value, stddev;
+	int lineno = 0;
+	int n;
+
+	while (fgets(line, sizeof (line), fp) != NULL) {
+		lineno++;
+		if (line[0] == '#' || strspn(line, " \t\r\n") == strlen(line))
+			continue;
+		if (sscanf(line, "%127s %lf %lf %d", name, &value, &stddev,
+		    &n) != 4 || n < 1) {
+			uperf_error("%s:%d: expected \"<name> <value> "
+			    "<stddev> <n>\"\n", file, lineno);
+			return (UPERF_FAILURE);
+		}
+		if (baseline_add(b, name, value, stddev, n) != UPERF_SUCCESS)
+			return (UPERF_FAILURE);
+	}
+
+	return (UPERF_SUCCESS);
+}
+
+/* Is the difference between a and b, both batched, significant at 95%? */
+static int
+significant(baseline_metric_t *a, baseline_metric_t *b)
+{
+	double va, vb, se, df;
+
+	va = a->stddev * a->stddev / a->n;
+	vb = b->stddev * b->stddev / b->n;
+	if ((se = sqrt(va + vb)) == 0)
+		return (a->value != b->value);
+	/* Welch-Satterthwaite */
+	df = (va + vb) * (va + vb) /
+	    (va * va / (a->n - 1) + vb * vb / (b->n - 1));
+
+	return (fabs(a->value - b->value) / se > batch_t_quantile((int)df));
+}
+
+static void
+print_metric(char *name, double v)
+{
+	char *dot = strrchr(name, '.');
+
+	if (strcmp(dot, ".thru") == 0)
+		PRINT_NUMb(v, 11);
+	else if (strcmp(dot, ".ops") == 0)
+		printf("%11.0f ", v);
+	else
+		PRINT_TIME(v, 11);
+}
+
+/* Print how this run compares to base, returns the regressions */
+static int
+baseline_compare(baseline_t *base, baseline_t *run, char *file)
+{
+	baseline_metric_t *b, *r;
+	double delta, worse;
+	int regressions = 0;
+	char *flag;
+	int i;
+
+	printf("\n%-31s %11s %11s %10s\n", "Baseline", "baseline",
+	    "current", "delta");
+	uperf_line();
+	for (i = 0; i < base->count; i++) {
+		b = &base->m[i];
+		printf("%-31s ", b->name);
+		print_metric(b->name, b->value);
+		if ((r = baseline_find(run, b->name)) == NULL) {
+			printf("%11s %10s missing\n", "-", "-");
+			continue;
+		}
+		print_metric(r->name, r->value);
+		delta = b->value != 0 ? 100.0 * (r->value - b->value) /
+		    b->value : 0;
+		worse = more_is_better(b->name) ? -delta : delta;
+		flag = "";
+		if (fabs(delta) > options.regress_pct) {
+			if (b->n < 2 || r->n < 2)
+				flag = "unbatched";
+			else if (significant(b, r) == 0)
+				flag = "noise";
+			else if (worse > 0)
+				flag = "REGRESSED";
+			else
+				flag = "improved";
+		}
+		if (*flag == 'R')
+			regressions++;
+		printf("%9.2f%% %s\n", delta, flag);
+	}
+	printf("\n%d of %d metrics regressed by more than %.2f%% against %s\n",
+	    regressions, base->count, options.regress_pct, file);
+
+	return (regressions);
+}
+
+/*
+ * Store the results in file if there is none yet, otherwise compare
+ * them against it. Returns the number of regressions, or -1.
+ */
+int
+baseline_process(uperf_shm_t *shm, char *file)
+{
+	baseline_t base, run;
+	FILE *fp;
+	int ret = -1;
+
+	bzero(&base, sizeof (base));
+	bzero(&run, sizeof (run));
+	update_aggr_stat(shm);
+	if (baseline_collect(shm, &run) != UPERF_SUCCESS) {
+		uperf_error("Cannot collect the baseline metrics\n");
+		goto out;
+	}
+	if ((fp = fopen(file, "r")) == NULL) {
+		if (errno != ENOENT) {
+			uperf_error("Cannot open baseline %s: %s\n", file,
+			    strerror(errno));
+			goto out;
+		}
+		if (baseline_write(&run, file) == UPERF_SUCCESS) {
+			printf("\nBaseline of %d metrics written to %s\n",
+			    run.count, file);
+			ret = 0;
+		}
+		goto out;
+	}
+	if (baseline_read(&base, fp, file) == UPERF_SUCCESS)
+		ret = baseline_compare(&base, &run, file);
+	(void) fclose(fp);
+out:
+	free(base.m);
+	free(run.m);
+
+	return (ret);
+}
@@ -0,0 +1,413 @@
+/*
+ * Copyright (C) 2008 Sun Microsystems
+ *
+ * This file is part of uperf.
+ *
+ * uperf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3
+ * as published by the Free Software Foundation.
+ *
+ * uperf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with uperf.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/*
+ * Batch means (-b). The measured part of every duration txn is cut
+ * into batches of options.batch nsecs. At the end of each batch the
+ * master samples the throughput of the txn and the latency
+ * percentiles of its flowops, so that a single run yields enough
+ * samples for a mean, a standard deviation and a 95% confidence
+ * interval. With -c, a txn ends as soon as the confidence interval of
+ * its throughput is narrower than options.ci_target percent of the
+ * mean.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif /* HAVE_STRING_H */
+#include <strings.h>
+
+#include "uperf.h"
+#include "main.h"
+#include "logging.h"
+#include "workorder.h"
+#include "stats.h"
+#include "strand.h"
+#include "shm.h"
+#include "numbers.h"
+#include "print.h"
+#include "batch.h"
+
+extern options_t options;
+
+#define	BATCH_HDR	"   Count        mean      stddev        cv      95% ci "
+
+/* How print_batch_row() formats a metric */
+#define	BATCH_BITS	0
+#define	BATCH_OPS	1
+#define	BATCH_TIME	2
+
+typedef struct batch_flowop {
+	int		gid;
+	txn_t		*txn;
+	flowop_t	*f;
+	uint64_t	hist[NSTAT_HIST_BUCKETS];	/* At batch start */
+	double		p50[BATCH_MAX];
+	double		p99[BATCH_MAX];
+} batch_flowop_t;
+
+typedef struct batch_txn {
+	int		txn;		/* Index of the txn */
+	int		n;		/* Batches sampled */
+	int		early;		/* Ended by the CI */
+	hrtime_t	next;		/* End of the current batch */
+	hrtime_t	last;		/* Start of the current batch */
+	hrtime_t	stop;		/* End of the measured part */
+	uint64_t	size;		/* Bytes moved at batch start */
+	uint64_t	count;		/* Ops done at batch start */
+	double		thru[BATCH_MAX];	/* bits/s */
+	double		ops[BATCH_MAX];		/* ops/s */
+	int		nflowops;
+	batch_flowop_t	*flowops;
+	struct batch_txn *next_txn;
+} batch_txn_t;
+
+static batch_txn_t *batches;	/* All sampled txns, latest first */
+static batch_txn_t *current;	/* Txn being sampled */
+
+/* Two-sided 95% quantiles of Student's t for 1..30 degrees of freedom */
+static const double t95[] = {
+	12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262,
+	2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101,
+	2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052,
+	2.048, 2.045, 2.042
+};
+
+double
+batch_t_quantile(int df)
+{
+	if (df < 1)
+		df = 1;
+	if (df <= 30)
+		return (t95[df - 1]);
+	if (df <= 60)
+		return (2.000);
+	if (df <= 120)
+		return (1.980);
+	return (1.960);
+}
+
+void
+batch_summarize(double *v, int n, batch_summary_t *bs)
+{
+	double sum = 0;
+	int i;
+
+	bzero(bs, sizeof (*bs));
+	if ((bs->n = n) == 0)
+		return;
+	for (i = 0; i < n; i++)
+		sum += v[i];
+	bs->mean = sum / n;
+	if (n < 2)
+		return;
+	sum = 0;
+	for (i = 0; i < n; i++)
+		sum += (v[i] - bs->mean) * (v[i] - bs->mean);
+	bs->stddev = sqrt(sum / (n - 1));
+	if (bs->mean != 0)
+		bs->cv = bs->stddev / bs->mean;
+	bs->ci = batch_t_quantile(n - 1) * bs->stddev / sqrt(n);
+}
+
+/* Sum of the histograms of f across strands */
+static void
+batch_flowop_hist(uperf_shm_t *shm, batch_flowop_t *bf, uint64_t *hist)
+{
+	int i, j;
+
+	bzero(hist, sizeof (uint64_t) * NSTAT_HIST_BUCKETS);
+	for (j = 0; j < shm->nstat_count; j++) {
+		newstats_t *p = &shm->nstats[j];
+
+		if (p->type != NSTAT_FLOWOP || p->gid != bf->gid ||
+		    p->tid != TXN_ID(bf->txn) || p->fid != FLOWOP_ID(bf->f))
+			continue;
+		for (i = 0; i < NSTAT_HIST_BUCKETS; i++)
+			hist[i] += p->hist[i];
+	}
+}
+
+/* Take the counters the next batch is measured against */
+static void
+batch_snap(uperf_shm_t *shm, batch_txn_t *bt, hrtime_t now)
+{
+	int i;
+
+	update_aggr_stat(shm);
+	bt->size = AGG_STAT(shm)->size;
+	bt->count = AGG_STAT(shm)->count;
+	bt->last = now;
+	for (i = 0; i < bt->nflowops; i++)
+		batch_flowop_hist(shm, &bt->flowops[i], bt->flowops[i].hist);
+}
+
+/* Record the batch that just ended */
+static void
+batch_sample(uperf_shm_t *shm, batch_txn_t *bt, hrtime_t now)
+{
+	newstats_t ns;
+	double secs = (now - bt->last) / 1.0e+9;
+	int i, j;
+
+	update_aggr_stat(shm);
+	bt->thru[bt->n] = (AGG_STAT(shm)->size - bt->size) * 8.0 / secs;
+	bt->ops[bt->n] = (AGG_STAT(shm)->count - bt->count) / secs;
+	for (i = 0; i < bt->nflowops; i++) {
+		batch_flowop_t *bf = &bt->flowops[i];
+
+		bzero(&ns, sizeof (ns));
+		ns.max = (uint64_t)-1;
+		batch_flowop_hist(shm, bf, ns.hist);
+		for (j = 0; j < NSTAT_HIST_BUCKETS; j++)
+			ns.hist[j] -= bf->hist[j];
+		bf->p50[bt->n] = stats_percentile(&ns, 50);
+		bf->p99[bt->n] = stats_percentile(&ns, 99);
+	}
+	bt->n++;
+}
+
+/* Start sampling txn (index), which the strands have just started */
+void
+batch_txn_begin(uperf_shm_t *shm, int txn)
+{
+	workorder_t *w = shm->workorder;
+	batch_txn_t *bt;
+	uint64_t from, to;
+	uint64_t len = 0;
+	txn_t *t;
+	flowop_t *f;
+	int i;
+
+	current = NULL;
+	if (options.batch == 0)
+		return;
+	for (i = 0; i < w->ngrp; i++)
+		for (t = w->grp[i].tlist; t; t = t->next)
+			if (TXN_ID(t) == txn && t->duration > 0)
+				len = MAX(len, t->duration);
+	if (len == 0)
+		return;
+	if (workorder_txn_window(w, txn, &from, &to) == 0) {
+		from = 0;
+		to = len;
+	}
+	if (to - from < BATCH_MIN * options.batch)
+		uperf_warn("Txn%d: %.2fs is not enough for %d batches\n",
+		    txn + 1, (to - from) / 1.0e+9, BATCH_MIN);
+
+	if ((bt = calloc(1, sizeof (batch_txn_t))) == NULL)
+		return;
+	bt->txn = txn;
+	/* Latencies need the histograms of -f */
+	for (i = 0; i < w->ngrp && ENABLED_FLOWOP_STATS(options); i++)
+		for (t = w->grp[i].tlist; t; t = t->next)
+			if (TXN_ID(t) == txn)
+				bt->nflowops += t->nflowop;
+	bt->flowops = calloc(MAX(bt->nflowops, 1), sizeof (batch_flowop_t));
+	if (bt->flowops == NULL) {
+		free(bt);
+		return;
+	}
+	bt->nflowops = 0;
+	for (i = 0; i < w->ngrp && ENABLED_FLOWOP_STATS(options); i++) {
+		for (t = w->grp[i].tlist; t; t = t->next) {
+			if (TXN_ID(t) != txn)
+				continue;
+			for (f = t->flist; f; f = f->next) {
+				bt->flowops[bt->nflowops].gid = i;
+				bt->flowops[bt->nflowops].txn = t;
+				bt->flowops[bt->nflowops].f = f;
+				bt->nflowops++;
+			}
+		}
+	}
+	/* The first "batch" just waits for the warmup to end */
+	bt->next = shm->txn_begin + from;
+	bt->stop = shm->txn_begin + to;
+	bt->last = 0;
+	bt->next_txn = batches;
+	batches = current = bt;
+}
+
+/*
+ * Txn (index) is over; a partial batch is dropped. Returns 1 if the
+ * CI ended it early.
+ */
+int
+batch_txn_end(uperf_shm_t *shm, int txn)
+{
+	current = NULL;
+
+	return (batches != NULL && batches->txn == txn && batches->early);
+}
+
+/*
+ * Close the batches that are over. Returns the time in ms until the
+ * next one ends, or -1 if no txn is being sampled.
+ */
+int
+batch_poll(uperf_shm_t *shm)
+{
+	batch_txn_t *bt = current;
+	batch_summary_t bs;
+	hrtime_t now;
+
+	if (bt == NULL)
+		return (-1);
+	now = GETHRTIME();
+	if (now < bt->next)
+		return ((bt->next - now) / 1000000 + 1);
+	if (bt->last != 0)
+		batch_sample(shm, bt, now);
+	if (bt->n >= BATCH_MAX || now + options.batch > bt->stop) {
+		current = NULL;
+		return (-1);
+	}
+	batch_snap(shm, bt, now);
+	bt->next = now + options.batch;
+
+	if (options.ci_target > 0 && bt->n >= BATCH_MIN) {
+		batch_summarize(bt->thru, bt->n, &bs);
+		if (bs.mean > 0 &&
+		    100.0 * bs.ci / bs.mean < options.ci_target) {
+			uperf_info("Txn%d: 95%% CI within %.2f%% after %d "
+			    "batches\n", bt->txn + 1, options.ci_target, bt->n);
+			bt->early = 1;
+			shm_stop_strands(shm, now);
+			current = NULL;
+			return (-1);
+		}
+	}
+
+	return (options.batch / 1000000 + 1);
+}
+
+/* Throughput of txn across its batches, 0 if it was not sampled */
+int
+batch_txn_summary(int txn, batch_summary_t *bs)
+{
+	batch_txn_t *bt;
+
+	for (bt = batches; bt; bt = bt->next_txn) {
+		if (bt->txn == txn && bt->n > 0) {
+			batch_summarize(bt->thru, bt->n, bs);
+			return (1);
+		}
+	}
+
+	return (0);
+}
+
+/* Latency percentiles of f across its batches, 0 if not sampled */
+int
+batch_flowop_summary(int gid, txn_t *txn, flowop_t *f, batch_summary_t *p50,
+    batch_summary_t *p99)
+{
+	batch_txn_t *bt;
+	int i;
+
+	for (bt = batches; bt; bt = bt->next_txn) {
+		if (bt->txn != TXN_ID(txn) || bt->n == 0)
+			continue;
+		for (i = 0; i < bt->nflowops; i++) {
+			batch_flowop_t *bf = &bt->flowops[i];
+
+			if (bf->gid == gid && bf->f == f) {
+				batch_summarize(bf->p50, bt->n, p50);
+				batch_summarize(bf->p99, bt->n, p99);
+				return (1);
+			}
+		}
+	}
+
+	return (0);
+}
+
+static void
+print_batch_row(char *name, double *v, int n, int type)
+{
+	batch_summary_t bs;
+
+	batch_summarize(v, n, &bs);
+	printf("%-15.15s %8d ", name, bs.n);
+	if (type == BATCH_TIME) {
+		PRINT_TIME(bs.mean, 11);
+		PRINT_TIME(bs.stddev, 11);
+	} else if (type == BATCH_BITS) {
+		PRINT_NUMb(bs.mean, 11);
+		PRINT_NUMb(bs.stddev, 11);
+	} else {
+		printf("%11.0f %11.0f ", bs.mean, bs.stddev);
+	}
+	printf("%9.2f%% ", 100.0 * bs.cv);
+	printf("%9.2f%%\n", bs.mean != 0 ? 100.0 * bs.ci / bs.mean : 0);
+}
+
+/* Mean, spread and 95% CI of every sampled txn */
+void
+print_batch_stats(void)
+{
+	batch_txn_t *bt;
+	batch_txn_t *list = NULL;
+	char name[64];
+	int i;
+
+	/* Oldest first */
+	while ((bt = batches) != NULL) {
+		batches = bt->next_txn;
+		bt->next_txn = list;
+		list = bt;
+	}
+	batches = list;
+	if (list == NULL)
+		return;
+
+	printf("\n%-15s %s\n", "Batch", BATCH_HDR);
+	uperf_line();
+	for (bt = batches; bt; bt = bt->next_txn) {
+		if (bt->n == 0)
+			continue;
+		(void) snprintf(name, sizeof (name), "Txn%d", bt->txn + 1);
+		print_batch_row(name, bt->thru, bt->n, BATCH_BITS);
+		(void) snprintf(name, sizeof (name), "Txn%d ops/s",
+		    bt->txn + 1);
+		print_batch_row(name, bt->ops, bt->n, BATCH_OPS);
+		for (i = 0; i < bt->nflowops; i++) {
+			batch_flowop_t *bf = &bt->flowops[i];
+
+			(void) snprintf(name, sizeof (name), "%s p50",
+			    bf->f->name);
+			print_batch_row(name, bf->p50, bt->n, BATCH_TIME);
+			(void) snprintf(name, sizeof (name), "%s p99",
+			    bf->f->name);
+			print_batch_row(name, bf->p99, bt->n, BATCH_TIME);
+		}
+		if (bt->early)
+			printf("Txn%d ended early: CI within %.2f%%\n",
+			    bt->txn + 1, options.ci_target);
+	}
+	printf("\n");
+}
@@ -0,0 +1,43 @@
+/* Copyright (C) 2008 Sun Microsystems
+ *
+ * This file is part of uperf.
+ *
+ * uperf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3
+ * as published by the Free Software Foundation.
+ *
+ * uperf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with uperf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BATCH_H
+#define	_BATCH_H
+
+#define	BATCH_MIN	5	/* Batches before the CI can end a txn */
+#define	BATCH_MAX	1024	/* Batches kept per txn */
+
+/* Summary of the samples of one metric */
+typedef struct batch_summary {
+	int	n;
+	double	mean;
+	double	stddev;
+	double	cv;		/* stddev/mean */
+	double	ci;		/* Half width of the 95% confidence interval */
+} batch_summary_t;
+
+void batch_txn_begin(uperf_shm_t *, int);
+int batch_txn_end(uperf_shm_t *, int);
+int batch_poll(uperf_shm_t *);
+void batch_summarize(double *, int, batch_summary_t *);
+double batch_t_quantile(int);
+int batch_txn_summary(int, batch_summary_t *);
+int batch_flowop_summary(int, txn_t *, flowop_t *, batch_summary_t *,
+    batch_summary_t *);
+void print_batch_stats(void);
+
+#endif /* _BATCH_H */
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2008 Sun Microsystems
+ *
+ * This file is part of uperf.
+ *
+ * uperf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3
+ * as published by the Free Software Foundation.
+ *
+ * uperf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with uperf.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/*
+ * I/O buffers of a strand. A group's buffers=N gives every strand N
+ * page aligned buffers that its reads and writes go through in turn,
+ * so that the data touched can be larger than the caches just like it
+ * is for real applications. With hugepages=on they are backed by huge
+ * pages: MAP_HUGETLB if the system has some reserved, transparent huge
+ * pages otherwise. The strand maps and touches the pool itself after it
+ * has been bound to its CPUs, which puts the memory on its NUMA node.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif /* HAVE_STRING_H */
+#include <strings.h>
+
+#include "uperf.h"
+#include "logging.h"
+#include "bufpool.h"
+
+#ifndef MAP_ANONYMOUS
+#define	MAP_ANONYMOUS	MAP_ANON
+#endif
+
+#define	ROUNDUP(x, a)	(((x) + (a) - 1) / (a) * (a))
+
+static char *
+bufpool_map(size_t len, int flags)
+{
+	char *p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+
+	return (p == MAP_FAILED ? NULL : p);
+}
+
+/*
+ * nbufs buffers of size bytes each, on huge pages if huge is set.
+ * Returns UPERF_SUCCESS, or UPERF_FAILURE if there is no memory.
+ */
+int
+bufpool_init(bufpool_t *p, size_t size, int nbufs, int huge)
+{
+	size_t page = sysconf(_SC_PAGESIZE);
+
+	bzero(p, sizeof (*p));
+	p->nbufs = MAX(nbufs, 1);
+	p->stride = ROUNDUP(size, page);
+	p->len = p->stride * p->nbufs;
+	p->backing = BUFPOOL_PAGES;
+	if (huge) {
+		p->len = ROUNDUP(p->len, BUFPOOL_HUGE_SIZE);
+#ifdef MAP_HUGETLB
+		if ((p->base = bufpool_map(p->len, MAP_HUGETLB)) != NULL)
+			p->backing = BUFPOOL_HUGETLB;
+#endif /* MAP_HUGETLB */
+	}
+	if (p->base == NULL && (p->base = bufpool_map(p->len, 0)) == NULL) {
+		uperf_error("Cannot map %lu bytes of buffers: %s\n",
+		    (unsigned long)p->len, strerror(errno));
+		return (UPERF_FAILURE);
+	}
+#ifdef MADV_HUGEPAGE
+	if (huge && p->backing == BUFPOOL_PAGES &&
+	    madvise(p->base, p->len, MADV_HUGEPAGE) == 0)
+		p->backing = BUFPOOL_THP;
+#endif /* MADV_HUGEPAGE */
+	if (huge && p->backing == BUFPOOL_PAGES)
+		uperf_info("No huge pages for the buffers, using pages\n");
+	/* Fault it all in now, and from this strand's node */
+	(void) memset(p->base, 0, p->len);
+	p->next = 0;
+
+	return (UPERF_SUCCESS);
+}
+
+void
+bufpool_fini(bufpool_t *p)
+{
+	if (p->base != NULL)
+		(void) munmap(p->base, p->len);
+	bzero(p, sizeof (*p));
+}
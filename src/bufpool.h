@@ -0,0 +1,46 @@
+/* Copyright (C) 2008 Sun Microsystems
+ *
+ * This file is part of uperf.
+ *
+ * uperf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3
+ * as published by the Free Software Foundation.
+ *
+ * uperf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with uperf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BUFPOOL_H
+#define	_BUFPOOL_H
+
+#define	BUFPOOL_MAX	65536		/* buffers= */
+#define	BUFPOOL_HUGE_SIZE	(2 * 1024 * 1024)
+
+/* What backs a pool */
+#define	BUFPOOL_PAGES	0		/* Regular pages */
+#define	BUFPOOL_HUGETLB	1		/* MAP_HUGETLB */
+#define	BUFPOOL_THP	2		/* Transparent huge pages */
+
+/* Page aligned I/O buffers of a strand, used in turn */
+typedef struct bufpool {
+	char	*base;
+	size_t	len;		/* Of the mapping */
+	size_t	stride;		/* From one buffer to the next */
+	int	nbufs;
+	int	next;
+	int	backing;	/* BUFPOOL_* */
+} bufpool_t;
+
+int bufpool_init(bufpool_t *, size_t, int, int);
+void bufpool_fini(bufpool_t *);
+
+/* The buffer to use next */
+#define	BUFPOOL_NEXT(p)	((p)->nbufs == 1 ? (p)->base :			\
+	(p)->base + (p)->stride * ((p)->next = ((p)->next + 1) % (p)->nbufs))
+
+#endif /* _BUFPOOL_H */
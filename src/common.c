@@ -32,6 +32,7 @@
 #include <stdio.h>
 #include <assert.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <unistd.h> /* for read(2) and write(2) */
 #include <netinet/in.h>
 #ifdef HAVE_STRING_H
@@ -46,6 +47,7 @@
 #include "strand.h"
 #include "shm.h"
 #include "common.h"
+#include "netstat.h"
 
 int
 update_strand_with_slave_info(uperf_shm_t *shm, slave_info_t *si,
@@ -73,14 +75,14 @@ create_protocols(uperf_shm_t *shm, int nthr, flowop_t *f,
     slave_info_t *sl, int ssid)
 {
 	protocol_t *p;
-	int i;
+	int i, port;
 	int protocol = f->options.protocol;
 
 	/* If already created, no need to repeat */
 	if (sl[0].port[protocol] > 0)
 		return (UPERF_SUCCESS);
 
-	if (f->options.port != 0) {
+	if (f->options.port != 0 && !FO_REUSEPORT(&f->options)) {
 		int port = htons(f->options.port);
 		p = create_protocol(protocol, " ", ntohs(port), SLAVE);
 		sl[0].port[protocol] = p->listen(p, (void *)&f->options);
@@ -95,19 +97,68 @@ create_protocols(uperf_shm_t *shm, int nthr, flowop_t *f,
 		return (UPERF_SUCCESS);
 	}
 
-	/* One port per thread */
+	/*
+	 * One port per thread. With reuseport, every thread has a listener
+	 * of its own on a shared port, and the kernel spreads the
+	 * connections over them.
+	 */
+	port = f->options.port;
 	for (i = 0; i < nthr; i++) {
 		strand_t *s = shm_get_strand(shm, i + ssid);
-		p = create_protocol(protocol, " ", ANY_PORT, SLAVE);
+		p = create_protocol(protocol, " ", port, SLAVE);
 		sl[i].port[protocol] = p->listen(p, (void *)&f->options);
 		if (sl[i].port[protocol] == UPERF_FAILURE) {
 			return (UPERF_FAILURE);
 		}
 		s->listen_conn[protocol] = p;
+		if (FO_REUSEPORT(&f->options)) {
+			port = sl[i].port[protocol];
+			s->shards++;
+		}
 	}
+	if (FO_REUSEPORT(&f->options) && shm->listen_overflows == 0)
+		(void) netstat_listen_overflows(&shm->listen_overflows);
+
 	return (UPERF_SUCCESS);
 }
 
+/*
+ * Report how many connections the sharded listeners took and how they
+ * were spread over them. Returns 0 if there were none.
+ */
+int
+accept_report(uperf_shm_t *shm, hrtime_t elapsed, char *buf, int len)
+{
+	uint64_t total, min, max, overflows;
+	double rate;
+	int i, n, rc;
+
+	total = max = 0;
+	min = UINT64_MAX;
+	for (i = n = 0; i < shm->no_strands; i++) {
+		strand_t *s = shm_get_strand(shm, i);
+
+		if (s->shards == 0)
+			continue;
+		n++;
+		total += s->accepts;
+		min = MIN(min, s->accepts);
+		max = MAX(max, s->accepts);
+	}
+	if (n == 0)
+		return (0);
+	rate = elapsed > 0 ? total / (elapsed / 1.0e+9) : 0.0;
+	rc = snprintf(buf, len, "accepts %"PRIu64" (%.0f/s) over %d "
+	    "shards, %"PRIu64"-%"PRIu64" each", total, rate, n, min, max);
+	if (rc > 0 && rc < len &&
+	    netstat_listen_overflows(&overflows) == UPERF_SUCCESS) {
+		rc += snprintf(buf + rc, len - rc, ", %"PRIu64" listen "
+		    "overflows", overflows - shm->listen_overflows);
+	}
+
+	return (rc);
+}
+
 
 /*
  * Take a group_t and for all ACCEPT, precreate
@@ -28,6 +28,9 @@ typedef enum {
 	UPERF_CMD_ERROR
 } uperf_cmd;
 
+/* Set in the value of UPERF_CMD_NEXT_TXN if -c ended the last txn */
+#define	UPERF_TXN_EARLY		0x80000000
+
 typedef struct {
 	char 		magic[64];
 	uperf_cmd	command;
@@ -35,6 +38,7 @@ typedef struct {
 } uperf_command_t;
 
 int preprocess_accepts(uperf_shm_t *, group_t *, slave_info_t **, int );
+int accept_report(uperf_shm_t *, hrtime_t, char *, int);
 int update_strand_with_slave_info(uperf_shm_t *, slave_info_t *, char *, int, int);
 int uperf_get_command(protocol_t *, uperf_command_t*, int);
 int uperf_send_command(protocol_t *p, uperf_cmd command, uint32_t val);
@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2008 Sun Microsystems
+ *
+ * This file is part of uperf.
+ *
+ * uperf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3
+ * as published by the Free Software Foundation.
+ *
+ * uperf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with uperf.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/*
+ * The compute flowop: work the CPU the way a server handling a request
+ * would, so that it competes with the network stack for the cores.
+ * There are three kernels, each working through an arena of wss bytes
+ * of its own:
+ *
+ *	hash	a chain of dependent multiply/xorshifts over the data;
+ *		bound by the latency of the ALUs
+ *	simd	independent multiply-adds that the compiler vectorizes;
+ *		bound by the vector units and cache bandwidth
+ *	chase	a walk through a random cycle of cache lines, one
+ *		dependent load per line; bound by memory latency
+ *
+ * The amount of work is given in bytes of arena (size=) or in time
+ * (duration=). Times are turned into bytes with the cost per byte of
+ * the kernel, which compute_calibrate() measures on an otherwise idle
+ * CPU of each host before the strands start. Under contention the
+ * same work then takes longer, and the flowop stats show by how much.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif /* HAVE_STRING_H */
+
+#include "uperf.h"
+#include "logging.h"
+#include "flowops.h"
+#include "workorder.h"
+#include "compute.h"
+
+#define	COMPUTE_LINE		64	/* Bytes per chase load */
+#define	CALIBRATE_TIME		10000000	/* ns */
+#define	CALIBRATE_CHUNK		(64 * 1024)
+
+static uint64_t
+kernel_hash(const char *buf, size_t len, uint64_t h)
+{
+	const uint64_t *w = (const uint64_t *)buf;
+	size_t i;
+
+	for (i = 0; i < len / sizeof (uint64_t); i++) {
+		h = (h ^ w[i]) * 0x100000001b3ULL;
+		h ^= h >> 32;
+	}
+
+	return (h);
+}
+
+static uint64_t
+kernel_simd(const char *buf, size_t len, uint64_t h)
+{
+	const uint32_t *w = (const uint32_t *)buf;
+	uint32_t acc[16];
+	size_t n = len / sizeof (uint32_t);
+	size_t i, j;
+
+	(void) memset(acc, 0, sizeof (acc));
+	for (i = 0; i + 16 <= n; i += 16)
+		for (j = 0; j < 16; j++)
+			acc[j] += w[i + j] * 2654435761U;
+	for (j = 0; j < 16; j++)
+		h += acc[j];
+
+	return (h);
+}
+
+/* Follow hops links from line *pos on, leaving *pos at the last */
+static uint64_t
+kernel_chase(const char *buf, uint64_t hops, size_t *pos)
+{
+	uint32_t i = *pos;
+
+	while (hops-- > 0)
+		i = *(const uint32_t *)(buf + (size_t)i * COMPUTE_LINE);
+	*pos = i;
+
+	return (i);
+}
+
+/*
+ * An arena of wss bytes for kernel. The lines of a chase arena are
+ * linked into a single random cycle (Sattolo's algorithm), so that
+ * every load misses unless the arena fits in the caches.
+ */
+compute_t *
+compute_init(int kernel, size_t wss)
+{
+	compute_t *c;
+	uint64_t x = 0x2545f4914f6cdd1dULL;
+	size_t i, j, lines;
+	uint32_t *link;
+	uint32_t t;
+
+	if ((c = calloc(1, sizeof (compute_t))) == NULL)
+		return (NULL);
+	c->len = MAX(wss / COMPUTE_LINE, 2) * COMPUTE_LINE;
+	if ((c->arena = malloc(c->len)) == NULL) {
+		uperf_error("Cannot allocate %lu bytes for compute\n",
+		    (unsigned long)c->len);
+		free(c);
+		return (NULL);
+	}
+	if (kernel != COMPUTE_CHASE) {
+		for (i = 0; i < c->len; i++)
+			c->arena[i] = (char)(i * 131 + 7);
+		return (c);
+	}
+	lines = c->len / COMPUTE_LINE;
+	if ((link = malloc(lines * sizeof (uint32_t))) == NULL) {
+		compute_free(c);
+		return (NULL);
+	}
+	for (i = 0; i < lines; i++)
+		link[i] = i;
+	for (i = lines - 1; i > 0; i--) {
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		j = x % i;
+		t = link[i];
+		link[i] = link[j];
+		link[j] = t;
+	}
+	for (i = 0; i < lines; i++)
+		*(uint32_t *)(c->arena + i * COMPUTE_LINE) = link[i];
+	free(link);
+
+	return (c);
+}
+
+void
+compute_free(compute_t *c)
+{
+	if (c == NULL)
+		return;
+	free(c->arena);
+	free(c);
+}
+
+/* Do bytes of kernel's work, carrying on where the last call stopped */
+void
+compute_run(compute_t *c, int kernel, uint64_t bytes)
+{
+	size_t n;
+
+	/* Whole lines, so that the hash and simd loads stay aligned */
+	bytes = (bytes + COMPUTE_LINE - 1) / COMPUTE_LINE * COMPUTE_LINE;
+	if (kernel == COMPUTE_CHASE) {
+		c->sum += kernel_chase(c->arena, bytes / COMPUTE_LINE, &c->pos);
+		return;
+	}
+	while (bytes > 0) {
+		n = MIN(bytes, c->len - c->pos);
+		if (kernel == COMPUTE_SIMD)
+			c->sum = kernel_simd(c->arena + c->pos, n, c->sum);
+		else
+			c->sum = kernel_hash(c->arena + c->pos, n, c->sum);
+		bytes -= n;
+		c->pos = (c->pos + n) % c->len;
+	}
+}
+
+/* Cost of kernel on an arena of wss bytes, in picoseconds per byte */
+static uint64_t
+calibrate(int kernel, size_t wss)
+{
+	compute_t *c;
+	hrtime_t start, elapsed;
+	uint64_t bytes = 0;
+
+	if ((c = compute_init(kernel, wss)) == NULL)
+		return (0);
+	/* Warm up the caches first */
+	compute_run(c, kernel, c->len);
+	start = GETHRTIME();
+	do {
+		compute_run(c, kernel, CALIBRATE_CHUNK);
+		bytes += CALIBRATE_CHUNK;
+	} while ((elapsed = GETHRTIME() - start) < CALIBRATE_TIME);
+	compute_free(c);
+
+	return (MAX(elapsed * 1000 / bytes, 1));
+}
+
+/* Calibrate the compute flowops of g */
+int
+compute_calibrate(group_t *g)
+{
+	txn_t *t;
+	flowop_t *f;
+
+	for (t = g->tlist; t; t = t->next) {
+		for (f = t->flist; f; f = f->next) {
+			if (f->type != FLOWOP_COMPUTE)
+				continue;
+			f->options.cost = calibrate(f->options.kernel,
+			    f->options.wss);
+			if (f->options.cost == 0)
+				return (UPERF_FAILURE);
+			uperf_info("%s: %.3f ns/byte\n", f->name,
+			    f->options.cost / 1000.0);
+		}
+	}
+
+	return (UPERF_SUCCESS);
+}
+
+/* Free what the compute flowops of g allocated */
+void
+compute_fini(group_t *g)
+{
+	txn_t *t;
+	flowop_t *f;
+
+	for (t = g->tlist; t; t = t->next) {
+		for (f = t->flist; f; f = f->next) {
+			compute_free(f->work);
+			f->work = NULL;
+		}
+	}
+}
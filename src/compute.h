@@ -0,0 +1,36 @@
+/* Copyright (C) 2008 Sun Microsystems
+ *
+ * This file is part of uperf.
+ *
+ * uperf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3
+ * as published by the Free Software Foundation.
+ *
+ * uperf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with uperf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _COMPUTE_H
+#define	_COMPUTE_H
+
+/* Arena of a compute flowop, see compute.c */
+typedef struct compute {
+	char		*arena;
+	size_t		len;
+	size_t		pos;	/* Where the next call starts */
+	uint64_t	sum;	/* Keeps the work from being elided */
+} compute_t;
+
+compute_t *compute_init(int, size_t);
+void compute_free(compute_t *);
+void compute_run(compute_t *, int, uint64_t);
+int compute_calibrate(group_t *);
+void compute_fini(group_t *);
+
+#endif /* _COMPUTE_H */
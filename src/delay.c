@@ -41,13 +41,14 @@
 #define NSEC_PER_SEC 1000000000L
 #define USEC_PER_SEC 1000000L
 
-#if defined (UPERF_ANDROID) || defined (HAVE_NANOSLEEP)
+#if defined (UPERF_ANDROID) || defined (HAVE_NANOSLEEP) || \
+	defined (HAVE_CLOCK_NANOSLEEP)
 static void nsecs_to_timespec(struct timespec *ts, hrtime_t duration_nsecs)
 {
 	ts->tv_sec = duration_nsecs / NSEC_PER_SEC;
 	ts->tv_nsec = duration_nsecs % NSEC_PER_SEC;
 }
-#endif /* defined (UPERF_ANDROID) || defined (HAVE_NANOSLEEP) */
+#endif /* UPERF_ANDROID || HAVE_NANOSLEEP || HAVE_CLOCK_NANOSLEEP */
 
 #ifdef UPERF_ANDROID
 static int fd;
@@ -122,17 +123,72 @@ int uperf_sleep(hrtime_t duration_nsecs)
 int
 uperf_spin(hrtime_t duration)
 {
-#define	PER_LOOP	10000
 	hrtime_t start;
-	int i;
-	long sum = 0;
 
+	/* Reading the clock is cheap; don't overshoot by a batch of work */
 	start = GETHRTIME();
-	while (((GETHRTIME() - start)) < duration) {
-		for (i = 0; i < PER_LOOP; i++) {
-			sum += i;
-		}
-	}
+	while (((GETHRTIME() - start)) < duration)
+		;
 
 	return (0);
 }
+
+#if defined (HAVE_CLOCK_NANOSLEEP) && defined (CLOCK_MONOTONIC) && \
+	!defined (UPERF_ANDROID)
+static hrtime_t
+monotonic_now(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((hrtime_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec);
+}
+
+/*
+ * The deadline is fixed before we go to sleep, so neither the setup
+ * nor a wakeup by a stray signal adds to the time asked for.
+ */
+int
+uperf_delay(hrtime_t duration, hrtime_t spin, hrtime_t *actual)
+{
+	hrtime_t start = monotonic_now();
+	hrtime_t deadline = start + duration;
+	struct timespec ts;
+	int error = 0;
+
+	if (duration > spin) {
+		nsecs_to_timespec(&ts, deadline - spin);
+		error = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+		    NULL);
+	}
+	if (error == 0) {
+		while (monotonic_now() < deadline)
+			;
+	}
+	*actual = monotonic_now() - start;
+	if (error != 0 && error != EINTR) {
+		char msg[512];
+		snprintf(msg, sizeof(msg), "Error sleeping for %.4fs\n",
+		    (duration * 1.0 / NSEC_PER_SEC));
+		uperf_log_msg(UPERF_LOG_ERROR, error, msg);
+	}
+	errno = error;
+
+	return (error);
+}
+#else
+int
+uperf_delay(hrtime_t duration, hrtime_t spin, hrtime_t *actual)
+{
+	hrtime_t start = GETHRTIME();
+	int error = 0;
+
+	if (duration > spin)
+		error = uperf_sleep(duration - spin);
+	if (error == 0 && GETHRTIME() - start < duration)
+		(void) uperf_spin(duration - (GETHRTIME() - start));
+	*actual = GETHRTIME() - start;
+
+	return (error);
+}
+#endif /* HAVE_CLOCK_NANOSLEEP */
@@ -28,6 +28,13 @@
 int uperf_sleep(hrtime_t);
 int uperf_spin(hrtime_t);
 
+/*
+ * Sleep against an absolute deadline, optionally spinning through the
+ * last part of it to hide timer slack and wakeup latency. The time
+ * actually taken is returned in the last argument.
+ */
+int uperf_delay(hrtime_t, hrtime_t, hrtime_t *);
+
 #ifdef UPERF_ANDROID
 /*
  * Initialize alarm to be able to wake up the device between transactions / flowops
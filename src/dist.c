@@ -0,0 +1,400 @@
+/*
+ * Copyright (C) 2008 Sun Microsystems
+ *
+ * This file is part of uperf.
+ *
+ * uperf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3
+ * as published by the Free Software Foundation.
+ *
+ * uperf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with uperf.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/*
+ * Random numbers and the distributions that message sizes and think
+ * times can be drawn from. Every strand owns its generator, so drawing
+ * a sample takes no locks and strands do not share a sequence.
+ *
+ *	fixed(v)
+ *	uniform(min,max)	also rand(min,max)
+ *	lognormal(median,sigma[,max])
+ *	pareto(min,alpha[,max])
+ *	bimodal(a,b,p)		a with probability p, else b
+ *	cdf(file)		empirical CDF, lines of "value probability"
+ *	exponential(mean[,max])
+ *	normal(mean,stddev[,max])
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <ctype.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif /* HAVE_STRING_H */
+#ifdef HAVE_STRINGS_H
+#include <strings.h>
+#endif /* HAVE_STRINGS_H */
+
+#include "uperf.h"
+#include "logging.h"
+#include "numbers.h"
+#include "dist.h"
+
+#define	DIST_MAXARGS	3
+#define	DIST_BAD	UINT64_MAX
+
+static uint64_t
+rotl(uint64_t x, int k)
+{
+	return ((x << k) | (x >> (64 - k)));
+}
+
+/* splitmix64 spreads a single seed over the whole xoshiro state */
+void
+rng_seed(rng_t *r, uint64_t seed)
+{
+	uint64_t z;
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		z = (seed += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		r->s[i] = z ^ (z >> 31);
+	}
+}
+
+uint64_t
+rng_next(rng_t *r)
+{
+	uint64_t *s = r->s;
+	uint64_t result = rotl(s[1] * 5, 7) * 9;
+	uint64_t t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl(s[3], 45);
+
+	return (result);
+}
+
+/* Uniform in [0, 1) */
+double
+rng_double(rng_t *r)
+{
+	return ((rng_next(r) >> 11) * (1.0 / 9007199254740992.0));
+}
+
+/* Uniform in [lo, hi] */
+uint64_t
+rng_uniform(rng_t *r, uint64_t lo, uint64_t hi)
+{
+	if (hi <= lo)
+		return (lo);
+	if (hi - lo == UINT64_MAX)
+		return (rng_next(r));
+	return (lo + rng_next(r) % (hi - lo + 1));
+}
+
+/* Standard normal variate (Box-Muller) */
+static double
+rng_normal(rng_t *r)
+{
+	double u = 1.0 - rng_double(r);	/* (0, 1] */
+	double v = rng_double(r);
+
+	return (sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v));
+}
+
+/* Convert a size (64k) or a time (10ms) to a number */
+static uint64_t
+dist_value(char *str, int unit)
+{
+	uint64_t ns;
+	int v;
+
+	if (str == NULL || *str == '\0')
+		return (DIST_BAD);
+	if (unit == DIST_NSEC) {
+		/* string_to_nsec() cannot tell 0 from an error */
+		if (strspn(str, "0") == strlen(str))
+			return (0);
+		ns = string_to_nsec(str);
+		return (ns == 0 || ns == (uint64_t)-1 ? DIST_BAD : ns);
+	}
+	if ((v = string_to_int(str)) < 0)
+		return (DIST_BAD);
+
+	return ((uint64_t)v);
+}
+
+static int
+dist_double(char *str, double *d)
+{
+	char *end;
+
+	if (str == NULL || *str == '\0')
+		return (-1);
+	*d = strtod(str, &end);
+
+	return (*end == '\0' ? 0 : -1);
+}
+
+static int
+dist_load_cdf(dist_t *d, char *file, int unit)
+{
+	char line[256];
+	char *v, *p;
+	double prob, last = 0.0;
+	int size = 0;
+	FILE *fp;
+
+	if ((fp = fopen(file, "r")) == NULL) {
+		uperf_error("Cannot open CDF file %s\n", file);
+		return (-1);
+	}
+	while (fgets(line, sizeof (line), fp) != NULL) {
+		v = strtok(line, " \t,\r\n");
+		if (v == NULL || *v == '#')
+			continue;
+		p = strtok(NULL, " \t,\r\n");
+		if (d->n == size) {
+			size = size ? size * 2 : 64;
+			d->val = realloc(d->val, size * sizeof (uint64_t));
+			d->cdf = realloc(d->cdf, size * sizeof (double));
+			if (d->val == NULL || d->cdf == NULL) {
+				uperf_error("Out of memory loading %s\n", file);
+				(void) fclose(fp);
+				return (-1);
+			}
+		}
+		d->val[d->n] = dist_value(v, unit);
+		if (d->val[d->n] == DIST_BAD || dist_double(p, &prob) != 0 ||
+		    prob < last || prob <= 0.0 ||
+		    (d->n > 0 && d->val[d->n] < d->val[d->n - 1])) {
+			uperf_error("%s: bad CDF point \"%s %s\"\n", file, v,
+			    p ? p : "");
+			(void) fclose(fp);
+			return (-1);
+		}
+		d->cdf[d->n++] = last = prob;
+	}
+	(void) fclose(fp);
+	if (d->n == 0) {
+		uperf_error("%s: no CDF points\n", file);
+		return (-1);
+	}
+	/* Accept percentiles as well as probabilities */
+	for (size = 0; size < d->n; size++)
+		d->cdf[size] /= last;
+	d->min = d->val[0];
+	d->max = d->val[d->n - 1];
+
+	return (0);
+}
+
+/*
+ * Parse a distribution spec such as lognormal(4k,1.5). unit is one of
+ * DIST_BYTES or DIST_NSEC. Returns NULL if the spec is not valid.
+ */
+dist_t *
+dist_parse(char *spec, int unit)
+{
+	char buf[PATHMAX];
+	char *name, *args, *end;
+	char *arg[DIST_MAXARGS] = { NULL, NULL, NULL };
+	uint64_t v[DIST_MAXARGS];
+	int nargs = 0;
+	int i;
+	dist_t *d;
+
+	(void) strlcpy(buf, spec, sizeof (buf));
+	if ((args = strchr(buf, '(')) == NULL ||
+	    (end = strrchr(buf, ')')) == NULL || end[1] != '\0')
+		return (NULL);
+	*args++ = '\0';
+	*end = '\0';
+	name = buf;
+	if ((d = calloc(1, sizeof (dist_t))) == NULL)
+		return (NULL);
+
+	if (strcasecmp(name, "cdf") == 0) {
+		d->type = DIST_CDF;
+		if (dist_load_cdf(d, args, unit) != 0)
+			goto bad;
+		return (d);
+	}
+
+	for (end = strtok(args, ","); end; end = strtok(NULL, ",")) {
+		if (nargs == DIST_MAXARGS)
+			goto bad;
+		arg[nargs++] = end;
+	}
+	for (i = 0; i < nargs; i++)
+		v[i] = dist_value(arg[i], unit);
+
+	if (strcasecmp(name, "fixed") == 0 && nargs == 1) {
+		d->type = DIST_FIXED;
+		if ((d->min = d->max = v[0]) == DIST_BAD)
+			goto bad;
+	} else if ((strcasecmp(name, "uniform") == 0 ||
+	    strcasecmp(name, "rand") == 0) && nargs == 2) {
+		d->type = DIST_UNIFORM;
+		d->min = v[0];
+		d->max = v[1];
+		if (d->min == DIST_BAD || d->max == DIST_BAD ||
+		    d->min > d->max)
+			goto bad;
+	} else if (strcasecmp(name, "lognormal") == 0 &&
+	    (nargs == 2 || nargs == 3)) {
+		d->type = DIST_LOGNORMAL;
+		if ((d->a = v[0]) == DIST_BAD || v[0] == 0 ||
+		    dist_double(arg[1], &d->b) != 0 || d->b < 0)
+			goto bad;
+		/* By default, cut the tail beyond 4 sigma */
+		d->max = nargs == 3 ? v[2] : (uint64_t)(d->a * exp(4 * d->b));
+		if (d->max == DIST_BAD)
+			goto bad;
+	} else if (strcasecmp(name, "pareto") == 0 &&
+	    (nargs == 2 || nargs == 3)) {
+		d->type = DIST_PARETO;
+		if ((d->a = v[0]) == DIST_BAD || v[0] == 0 ||
+		    dist_double(arg[1], &d->b) != 0 || d->b <= 0)
+			goto bad;
+		d->min = v[0];
+		/* By default, cut the tail beyond the 99.99th percentile */
+		d->max = nargs == 3 ? v[2] :
+		    (uint64_t)(d->a * pow(1.0e4, 1.0 / d->b));
+		if (d->max == DIST_BAD || d->max < d->min)
+			goto bad;
+	} else if (strcasecmp(name, "exponential") == 0 &&
+	    (nargs == 1 || nargs == 2)) {
+		d->type = DIST_EXPONENTIAL;
+		if ((d->a = v[0]) == DIST_BAD || v[0] == 0)
+			goto bad;
+		/* By default, cut the tail beyond the 99.99th percentile */
+		d->max = nargs == 2 ? v[1] : (uint64_t)(d->a * log(1.0e4));
+		if (d->max == DIST_BAD)
+			goto bad;
+	} else if (strcasecmp(name, "normal") == 0 &&
+	    (nargs == 2 || nargs == 3)) {
+		d->type = DIST_NORMAL;
+		if ((d->a = v[0]) == DIST_BAD || v[1] == DIST_BAD)
+			goto bad;
+		d->b = v[1];
+		/* Negative values are clamped to 0, and by default 4 sigma */
+		d->max = nargs == 3 ? v[2] : (uint64_t)(d->a + 4 * d->b);
+		if (d->max == DIST_BAD)
+			goto bad;
+	} else if (strcasecmp(name, "bimodal") == 0 && nargs == 3) {
+		d->type = DIST_BIMODAL;
+		if (v[0] == DIST_BAD || v[1] == DIST_BAD ||
+		    dist_double(arg[2], &d->c) != 0 || d->c < 0 || d->c > 1)
+			goto bad;
+		d->a = v[0];
+		d->b = v[1];
+		d->min = MIN(v[0], v[1]);
+		d->max = MAX(v[0], v[1]);
+	} else {
+		goto bad;
+	}
+
+	return (d);
+bad:
+	free(d->val);
+	free(d->cdf);
+	free(d);
+	return (NULL);
+}
+
+static uint64_t
+dist_cdf_sample(dist_t *d, double u)
+{
+	int lo = 0;
+	int hi = d->n - 1;
+	int mid;
+
+	/* First point whose cumulative probability covers u */
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (d->cdf[mid] > u)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	return (d->val[lo]);
+}
+
+uint64_t
+dist_sample(dist_t *d, rng_t *r)
+{
+	double x;
+
+	switch (d->type) {
+	case DIST_FIXED:
+		return (d->min);
+	case DIST_UNIFORM:
+		return (rng_uniform(r, d->min, d->max));
+	case DIST_LOGNORMAL:
+		x = d->a * exp(d->b * rng_normal(r));
+		break;
+	case DIST_PARETO:
+		x = d->a / pow(1.0 - rng_double(r), 1.0 / d->b);
+		break;
+	case DIST_EXPONENTIAL:
+		x = -d->a * log(1.0 - rng_double(r));
+		break;
+	case DIST_NORMAL:
+		x = d->a + d->b * rng_normal(r);
+		break;
+	case DIST_BIMODAL:
+		return (rng_double(r) < d->c ? (uint64_t)d->a : (uint64_t)d->b);
+	case DIST_CDF:
+		return (dist_cdf_sample(d, rng_double(r)));
+	default:
+		return (d->min);
+	}
+	if (x < d->min)
+		return (d->min);
+	if (x > d->max)
+		return (d->max);
+
+	return ((uint64_t)x);
+}
+
+/* A representative value: the mean, or the median for heavy tails */
+uint64_t
+dist_nominal(dist_t *d)
+{
+	switch (d->type) {
+	case DIST_UNIFORM:
+		return ((d->min + d->max) / 2);
+	case DIST_LOGNORMAL:
+	case DIST_EXPONENTIAL:
+	case DIST_NORMAL:
+		return ((uint64_t)d->a);
+	case DIST_PARETO:
+		return ((uint64_t)(d->a * pow(2.0, 1.0 / d->b)));
+	case DIST_BIMODAL:
+		return ((uint64_t)(d->c * d->a + (1 - d->c) * d->b));
+	case DIST_CDF:
+		return (dist_cdf_sample(d, 0.5));
+	default:
+		return (d->min);
+	}
+}
@@ -0,0 +1,62 @@
+/* Copyright (C) 2008 Sun Microsystems
+ *
+ * This file is part of uperf.
+ *
+ * uperf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3
+ * as published by the Free Software Foundation.
+ *
+ * uperf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with uperf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DIST_H
+#define	_DIST_H
+
+/* Per-strand pseudo random number generator (xoshiro256**) */
+typedef struct rng {
+	uint64_t	s[4];
+} rng_t;
+
+typedef enum {
+	DIST_FIXED = 0,
+	DIST_UNIFORM,
+	DIST_LOGNORMAL,
+	DIST_PARETO,
+	DIST_BIMODAL,
+	DIST_CDF,
+	DIST_EXPONENTIAL,
+	DIST_NORMAL
+} dist_type_t;
+
+/* What the values of a distribution are */
+#define	DIST_BYTES	0
+#define	DIST_NSEC	1
+
+typedef struct dist {
+	dist_type_t	type;
+	double		a;	/* Parameters; meaning depends on type */
+	double		b;
+	double		c;
+	uint64_t	min;	/* Samples are clamped to [min, max] */
+	uint64_t	max;
+	int		n;	/* Points of an empirical CDF */
+	uint64_t	*val;
+	double		*cdf;
+} dist_t;
+
+void rng_seed(rng_t *, uint64_t);
+uint64_t rng_next(rng_t *);
+double rng_double(rng_t *);
+uint64_t rng_uniform(rng_t *, uint64_t, uint64_t);
+
+dist_t *dist_parse(char *, int);
+uint64_t dist_sample(dist_t *, rng_t *);
+uint64_t dist_nominal(dist_t *);
+
+#endif /* _DIST_H */
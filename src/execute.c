@@ -26,6 +26,8 @@
 #include <math.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <sys/types.h>
+#include <sys/socket.h>
 #include "uperf.h"
 #include "sync.h"
 #include "logging.h"
@@ -35,12 +37,18 @@
 #include "strand.h"
 #include "shm.h"
 #include "rate.h"
+#include "async.h"
+#include "affinity.h"
+#include "compute.h"
+#include "flowops_library.h"
 
 extern options_t options;
 typedef int (*generic_execute_func)(strand_t *, void *);
 
 /*
- * Execute a function for specified duration
+ * Execute a function for specified duration. The strand stops by
+ * itself at "stop": SIGNALLED() becomes true and blocking I/O gives
+ * up as the deadline passes.
  */
 static int
 duration_execute(strand_t *sp, void *b, hrtime_t stop,
@@ -48,62 +56,251 @@ duration_execute(strand_t *sp, void *b, hrtime_t stop,
 {
 	int error = 0;
 
-	if (STRAND_IS_LEADER(sp))
-		shm_callout_register(sp->shmptr, stop, sp->worklist->groupid);
+	sp->deadline = stop;
 
 	/* We call "callback" multiple times as it might be a rate function */
-	while (error == 0)
+	while (error == 0 && !SIGNALLED(sp))
 		error = callback(sp, b);
 
-	return (error);
+	return (error == 0 ? UPERF_DURATION_EXPIRED : error);
+}
+
+/*
+ * A txn compiled for one strand before it runs: its flowops as a flat
+ * array of steps, with the function to run each one and what is to be
+ * recorded for it worked out once instead of on every op.
+ */
+typedef struct plan_step {
+	flowop_t	*f;
+	execute_func	execute;	/* See flowop_plan_execute_func() */
+	uint64_t	count;
+	int		canfail;
+	int		coalesce;	/* All count at once, flowop_coalesce() */
+	int		record;		/* STATS_RECORD_FLOWOP */
+	int		begin;		/* FLOWOP_BEGIN needed outside windows */
+} plan_step_t;
+
+typedef struct plan {
+	plan_step_t	*step;
+	plan_step_t	*resp;		/* First step of a pipelined response */
+	plan_step_t	*end;
+} plan_t;
+
+static void
+plan_free(txn_t *txn)
+{
+	if (txn->plan == NULL)
+		return;
+	free(txn->plan->step);
+	free(txn->plan);
+	txn->plan = NULL;
+}
+
+static int
+plan_compile(txn_t *txn)
+{
+	plan_step_t *st;
+	plan_t *pl;
+	flowop_t *f;
+	int n = 0;
+
+	for (f = txn->flist; f; f = f->next)
+		n++;
+	if ((pl = calloc(1, sizeof (plan_t))) == NULL ||
+	    (pl->step = calloc(MAX(n, 1), sizeof (plan_step_t))) == NULL) {
+		ulog_err("calloc");
+		free(pl);
+		return (UPERF_FAILURE);
+	}
+	for (f = txn->flist, st = pl->step; f; f = f->next, st++) {
+		st->f = f;
+		st->execute = flowop_plan_execute_func(f);
+		st->count = f->options.count;
+		st->canfail = FO_CANFAIL(&f->options) != 0;
+		st->coalesce = f->options.coalesce != COALESCE_NONE &&
+		    (f->type == FLOWOP_WRITE || f->type == FLOWOP_SEND);
+		st->record = ENABLED_STATS(options);
+		st->begin = st->record && (ENABLED_FLOWOP_STATS(options) ||
+		    ENABLED_GROUP_STATS(options) ||
+		    ENABLED_HISTORY_STATS(options));
+		if (pl->resp == NULL && f->type != FLOWOP_WRITE &&
+		    f->type != FLOWOP_SEND)
+			pl->resp = st;
+	}
+	pl->end = st;
+	if (pl->resp == NULL)
+		pl->resp = pl->end;
+	txn->plan = pl;
+
+	return (UPERF_SUCCESS);
 }
 
 /* Returns one of UPERF_SUCCESS, UPERF_FAILURE, UPERF_DURATAION_EXPIRED */
 static int
-flowop_execute(strand_t *sp, flowop_t *fp)
+step_execute(strand_t *sp, plan_step_t *st)
 {
+	flowop_t *fp = st->f;
 	uint64_t i;
 	int ret = 0;
 	int save_errno;
 
-	STATS_RECORD_FLOWOP(FLOWOP_BEGIN, sp, FLOWOP_STAT(fp), 0, 0);
-	for (i = 0; i < fp->options.count; i++) {
-		if (SIGNALLED(sp)) {
-			return (UPERF_DURATION_EXPIRED);
-		}
-		ret = fp->execute(sp, fp);
-		if (FO_CANFAIL(&fp->options) && ret < 0) {
+	/* Only a measurement window needs it for the rest */
+	if (st->begin || (st->record && sp->measure_end != 0))
+		stats_update(FLOWOP_BEGIN, sp, FLOWOP_STAT(fp), 0, 0);
+	if (st->coalesce) {
+		if ((ret = flowop_coalesce(sp, fp, st->count, &i)) < 0 &&
+		    st->canfail)
 			ret = 0;
-		} else if (ret < 0)
-			break;
+	} else {
+		for (i = 0; i < st->count; i++) {
+			if (i > 0 && SIGNALLED(sp))
+				return (UPERF_DURATION_EXPIRED);
+			if ((ret = st->execute(sp, fp)) < 0) {
+				if (!st->canfail)
+					break;
+				ret = 0;
+			}
+		}
 	}
 	save_errno = errno;
-	STATS_RECORD_FLOWOP(FLOWOP_END, sp, FLOWOP_STAT(fp), ret, i);
-	if ((save_errno == EINTR) || SIGNALLED(sp)) {
+	if (st->record)
+		stats_update(FLOWOP_END, sp, FLOWOP_STAT(fp), ret, i);
+	if (save_errno == EINTR || (ret < 0 && SIGNALLED(sp)))
 		return (UPERF_DURATION_EXPIRED);
-	}
+
 	return (ret >= 0 ? UPERF_SUCCESS : UPERF_FAILURE);
 }
 
+/*
+ * Run steps st up to end. Checking for the end of the txn between two
+ * steps does for the check after one and the one before the next.
+ *
+ * Returns one of UPERF_SUCCESS, UPERF_FAILURE, UPERF_DURATAION_EXPIRED
+ */
+static int
+plan_execute(strand_t *sp, plan_step_t *st, plan_step_t *end)
+{
+	int ret = UPERF_SUCCESS;
+
+	for (; st < end && ret == UPERF_SUCCESS; st++) {
+		if (SIGNALLED(sp))
+			return (UPERF_DURATION_EXPIRED);
+		ret = step_execute(sp, st);
+	}
+
+	return (ret);
+}
+
 /* Returns one of UPERF_SUCCESS, UPERF_FAILURE, UPERF_DURATAION_EXPIRED */
 static int
 txn_execute_once(strand_t *strand, txn_t *txn)
 {
-	flowop_t *f;
-	int ret = UPERF_SUCCESS;
+	int ret;
 
 	if (ENABLED_TXN_STATS(options)) {
 		stats_update(TXN_BEGIN, strand, TXN_STAT(txn), 0, 0);
 	}
 	/* Execute flowops untill ERROR or DURATION_EXPIRED */
-	for (f = txn->flist; f && ret == UPERF_SUCCESS; f = f->next) {
-		ret = flowop_execute(strand, f);
-	}
+	ret = plan_execute(strand, txn->plan->step, txn->plan->end);
 	if (ENABLED_TXN_STATS(options)) {
 		stats_update(TXN_END, strand, TXN_STAT(txn), 0, 1);
 	}
 	return (ret);
 }
+/*
+ * Does txn keep several requests in flight? Only the side that sends
+ * the requests pipelines; the peer just answers them in order.
+ */
+#define	TXN_PIPELINED(t)	((t)->pipeline > 1 &&		\
+	((t)->flist->type == FLOWOP_WRITE || (t)->flist->type == FLOWOP_SEND))
+
+/*
+ * How many requests can be in flight. The peer answers them one at a
+ * time: once writing requests blocks, it can be blocked on responses
+ * that are not read, and neither side gets anywhere. Requests that fit
+ * in the send buffer never block. Linux reports twice the data it
+ * holds, so only half of that is counted on.
+ */
+static uint64_t
+pipeline_depth(strand_t *sp, plan_t *pl, uint64_t depth)
+{
+	flowop_options_t *o;
+	plan_step_t *st;
+	protocol_t *p;
+	uint64_t req = 0;
+	socklen_t len;
+	int sndbuf;
+
+	for (st = pl->step; st < pl->resp; st++) {
+		o = &st->f->options;
+		req += (uint64_t)(FO_RANDOM_SIZE(o) ? o->rand_sz_max :
+		    o->size) * MAX(o->iov, 1) * st->count;
+	}
+	p = strand_get_connection(sp, pl->step->f->p_id);
+	len = (socklen_t)sizeof (sndbuf);
+	if (req == 0 || p == NULL || p->fd < 0 ||
+	    getsockopt(p->fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, &len) != 0)
+		return (depth);
+	if ((uint64_t)sndbuf / 2 / req < depth) {
+		depth = MAX(1, (uint64_t)sndbuf / 2 / req);
+		uperf_info("%s: %lu requests in flight fit in the send "
+		    "buffer\n", pl->step->f->name, (unsigned long)depth);
+	}
+
+	return (depth);
+}
+
+/*
+ * Pipelined request/response. The leading write/send flowops of txn
+ * make up a request and the read/recv flowops after them its
+ * response. Up to txn->pipeline requests are kept in flight, and as
+ * responses come back in order, each one completes the oldest
+ * outstanding request. The round trip of every request is recorded
+ * in the txn stats. iter == 0 runs until the duration expires.
+ *
+ * Returns one of UPERF_SUCCESS, UPERF_FAILURE, UPERF_DURATAION_EXPIRED
+ */
+static int
+txn_pipeline(strand_t *sp, txn_t *txn, uint64_t iter)
+{
+	hrtime_t *issued;
+	plan_t *pl = txn->plan;
+	newstats_t *ns = TXN_STAT(txn);
+	uint64_t depth = pipeline_depth(sp, pl, txn->pipeline);
+	uint64_t sent = 0;
+	uint64_t done = 0;
+	int ret = UPERF_SUCCESS;
+
+	if ((issued = calloc(depth, sizeof (hrtime_t))) == NULL)
+		return (UPERF_FAILURE);
+
+	while (ret == UPERF_SUCCESS && (iter == 0 || done < iter)) {
+		if (sent - done < depth && (iter == 0 || sent < iter)) {
+			issued[sent % depth] = GETHRTIME();
+			ret = plan_execute(sp, pl->step, pl->resp);
+			sent++;
+			continue;
+		}
+		ret = plan_execute(sp, pl->resp, pl->end);
+		if (ret == UPERF_SUCCESS && ns != NULL &&
+		    ENABLED_TXN_STATS(options)) {
+			stats_update(TXN_BEGIN, sp, ns, 0, 0);
+			ns->time_used_start = issued[done % depth];
+			stats_update(TXN_END, sp, ns, 0, 1);
+		}
+		done++;
+	}
+	free(issued);
+
+	return (ret);
+}
+
+static int
+txn_pipeline_callback(strand_t *sp, void *tp)
+{
+	return (txn_pipeline(sp, (txn_t *) tp, 0));
+}
+
 /* Void * version of txn_execute_once. Used as callback for txn_duration() */
 static int
 txn_duration_callback(strand_t *sp, void *tp)
@@ -118,6 +315,13 @@ txn_rate_callback(void *a, void *b)
 }
 
 
+/* Multiplex a data txn over all connections until signalled */
+static int
+txn_async_callback(strand_t *sp, void *tp)
+{
+	return (async_txn_execute(sp, (txn_t *) tp, 0));
+}
+
 static int
 txn_execute_rate(strand_t *sp, void *tp)
 {
@@ -126,10 +330,10 @@ txn_execute_rate(strand_t *sp, void *tp)
 
 	if (sp->shmptr->role == MASTER)
 		return (rate_execute_1s(sp, txnp, txnp->rate_count,
-						&txn_rate_callback));
+						sp->deadline, &txn_rate_callback));
 	else
 		return (rate_execute_1s_busywait(sp, txnp, txnp->rate_count,
-						&txn_rate_callback));
+						sp->deadline, &txn_rate_callback));
 
 }
 
@@ -138,25 +342,51 @@ static int
 txn_duration(strand_t *s, txn_t *txn)
 {
 	hrtime_t stop;
+	uint64_t from, to;
 	generic_execute_func callback;
+	int error;
 
 	stop = s->shmptr->txn_begin + txn->duration;
+	if (group_txn_window(s->worklist, txn->txnid, &from, &to)) {
+		s->measure_start = s->shmptr->txn_begin + from;
+		s->measure_end = s->shmptr->txn_begin + to;
+	}
 
-	if (txn->rate_count == 0)
+	if (GROUP_IS_ASYNC(s->worklist) && async_txn(txn))
+		callback = &txn_async_callback;
+	else if (TXN_PIPELINED(txn))
+		callback = &txn_pipeline_callback;
+	else if (txn->rate_count == 0)
 		callback = &txn_duration_callback;
 	else
 		callback = &txn_execute_rate;
 
-	return (duration_execute(s, txn, stop, callback));
+	error = duration_execute(s, txn, stop, callback);
+	s->measure_start = s->measure_end = 0;
+
+	return (error);
 }
 
 static int
 txn_iterations(strand_t *sp, txn_t *tp)
 {
-	int i;
+	uint64_t i;
+	uint64_t iter = tp->iter;
 	int error = UPERF_SUCCESS;
 
-	for (i = 0; i < tp->iter && error == UPERF_SUCCESS; i++)
+	/*
+	 * With nconns, data txns are multiplexed over the connections
+	 * and everything else (connect, accept, ...) is done once per
+	 * connection.
+	 */
+	if (GROUP_IS_ASYNC(sp->worklist)) {
+		if (async_txn(tp))
+			return (async_txn_execute(sp, tp, tp->iter));
+		iter *= sp->worklist->max_async;
+	}
+	if (TXN_PIPELINED(tp))
+		return (txn_pipeline(sp, tp, iter));
+	for (i = 0; i < iter && error == UPERF_SUCCESS; i++)
 		error = txn_execute_once(sp, tp);
 
 	return (error);
@@ -185,7 +415,20 @@ group_execute(strand_t *strand, group_t *g)
 	int error = 0;
 	txn_t *txn;
 
-	strand->buffer = (char *) calloc(1, group_max_dto_size(g));
+	strand->bufsize = group_max_dto_size(g);
+	if (bufpool_init(&strand->pool, strand->bufsize, g->nbuffers,
+	    g->hugepages) != UPERF_SUCCESS)
+		return (UPERF_FAILURE);
+	strand->buffer = strand->pool.base;
+	for (txn = g->tlist; txn; txn = txn->next) {
+		if (plan_compile(txn) != UPERF_SUCCESS) {
+			error = UPERF_FAILURE;
+			goto out;
+		}
+	}
+	rng_seed(&strand->rng, GETHRTIME() ^ (uintptr_t)strand);
+	if (GROUP_IS_ASYNC(g))
+		(void) async_group_init(g);
 	if (ENABLED_GROUP_STATS(options))
 		stats_update(GROUP_BEGIN, strand, GROUP_STAT(g), 0, 0);
 	for (txn = g->tlist; txn; txn = txn->next) {
@@ -198,7 +441,9 @@ group_execute(strand_t *strand, group_t *g)
 			break;
 		}
 		strand->strand_state = STRAND_STATE_EXECUTING;
+		strand_cpu_sample(strand);
 		error = txn_execute(strand, txn);
+		strand_cpu_sample(strand);
 		CLEAR_SIGNAL(strand);
 
 		/*
@@ -212,7 +457,14 @@ group_execute(strand_t *strand, group_t *g)
 	strand->strand_state = STRAND_STATE_EXIT;
 	if (ENABLED_GROUP_STATS(options))
 		stats_update(GROUP_END, strand, GROUP_STAT(g), 0, 1);
-	free(strand->buffer);
+out:
+	for (txn = g->tlist; txn; txn = txn->next)
+		plan_free(txn);
+	bufpool_fini(&strand->pool);
+	strand->buffer = NULL;
+	free(strand->appbuf);
+	strand->appbuf = NULL;
+	compute_fini(g);
 
 	return (error);
 }
@@ -53,6 +53,8 @@ static struct flowop_id flowops[] = {
 	{ "recv", 	FLOWOP_RECV },
 	{ "sendfile", 	FLOWOP_SENDFILE },
 	{ "sendfilev", 	FLOWOP_SENDFILEV },
+	{ "replay", 	FLOWOP_REPLAY },
+	{ "compute", 	FLOWOP_COMPUTE },
 };
 
 struct flowop_opp {
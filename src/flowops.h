@@ -36,6 +36,8 @@ typedef enum {
 	FLOWOP_RECV,
 	FLOWOP_SENDFILEV,
 	FLOWOP_SENDFILE,
+	FLOWOP_REPLAY,
+	FLOWOP_COMPUTE,
 	FLOWOP_NUMTYPES
 }flowop_type_t;
 
@@ -33,6 +33,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <arpa/inet.h>
 #include "uperf.h"
 #include "protocol.h"
 #include "logging.h"
@@ -44,59 +45,378 @@
 #include "shm.h"
 #include "delay.h"
 #include "sendfilev.h"
+#include "flowops_library.h"
+#include "replay.h"
+#include "touch.h"
+#include "verify.h"
+#include "compute.h"
+#include "generic.h"
 
 extern options_t options;
 
 #define	UPERF_STOP_MSG		"Stop Writes"
 
+#ifndef MSG_MORE
+#define	MSG_MORE	0	/* coalesce=more sends them one by one */
+#endif
+
 typedef int (*flowop_rw_execute)(protocol_t *, void *buf, int sz, void *o);
 
-/* Return a random number uniformly distributed between x and y */
+/*
+ * Draw a message size for f from its distribution. The slave only
+ * knows the range, so it falls back to a uniform draw.
+ */
 static uint32_t
-my_random(uint32_t x, uint32_t y)
+flowop_random_size(strand_t *s, flowop_t *f)
 {
-	long range;
-	double d;
-
-	range = y - x + 1;
-	d = x + rand() % range;
-	if (d > y)
-		d = y;
-	return ((uint32_t) d);
+	flowop_options_t *o = &f->options;
+	uint64_t sz;
+
+	if (f->dist == NULL)
+		return (rng_uniform(&s->rng, o->rand_sz_min, o->rand_sz_max));
+	sz = dist_sample(f->dist, &s->rng);
+
+	return (MAX(1, MIN(sz, o->rand_sz_max)));
 }
 
 
+/* Log why an I/O call of f failed, unless the txn is just over */
+static void
+flowop_rw_error(flowop_t *f)
+{
+	int serrno = errno;
+	char msg[1024];
+
+	if (serrno == EINTR)
+		return;
+	snprintf(msg, sizeof(msg), "Error for flowop %s ", f->name);
+	uperf_log_msg(UPERF_LOG_ERROR, serrno, msg);
+	/* snprintf could change errno */
+	errno = serrno;
+}
+
+/*
+ * Move size bytes at buf with func. With partial set (random sizes
+ * without framing), whatever the first call moves is enough. Returns
+ * the number of bytes moved, or -1 with errno set.
+ */
 static int
-flowop_rw(strand_t *s, flowop_t *f)
+flowop_rw_fully(strand_t *s, flowop_t *f, flowop_rw_execute func,
+    char *buf, int size, int partial)
 {
 	int n;
-	int sz;
-	flowop_rw_execute func = NULL;
-	flowop_options_t *fo = &f->options;
+	int sz = 0;
 
-	if (f->connection == NULL) {
-		f->connection = strand_get_connection(s, f->p_id);
-		if (f->connection == NULL) {
-			char msg[1024];
-			snprintf(msg, sizeof(msg), "No such connection %d", f->p_id);
-			uperf_log_msg(UPERF_LOG_ERROR, 0, msg);
+	f->connection->deadline = s->deadline;
+	while (sz < size) {
+		/* Our caller has just checked before the first call */
+		if (sz > 0 && SIGNALLED(s))
+			return (-1);
+		n = func(f->connection, buf + sz, size - sz, &f->options);
+		/*
+		 * read(2) and write(2) can return 0 in case of a
+		 * hangup. For this case, we just assume that the
+		 * duration has expired and return
+		 */
+		if (n == 0 || (n < 0 && PEER_RESET(s))) {
+			errno = EINTR;
+			return (-1);
+		}
+		if (n <= 0) {
+			flowop_rw_error(f);
+			return (-1);
+		}
+		sz += n;
+		if (partial)
+			break;
+	}
+
+	return (sz);
+}
+
+/*
+ * Like flowop_rw_fully(), for the cnt segments at iov: sendmsg (out)
+ * or recvmsg until all of them are through, with flags on every call.
+ * iov is consumed. Returns the number of bytes moved, or -1.
+ */
+static int
+flowop_iov_fully(strand_t *s, flowop_t *f, int out, struct iovec *iov,
+    int cnt, int flags)
+{
+	int n;
+	int sz = 0;
+
+	f->connection->deadline = s->deadline;
+	while (cnt > 0) {
+		if (sz > 0 && SIGNALLED(s))
+			return (-1);
+		n = generic_iov(f->connection, out, iov, cnt, flags);
+		if (n == 0 || (n < 0 && PEER_RESET(s))) {
+			errno = EINTR;
 			return (-1);
 		}
+		if (n < 0) {
+			flowop_rw_error(f);
+			return (-1);
+		}
+		sz += n;
+		for (; cnt > 0 && n >= iov->iov_len; iov++, cnt--)
+			n -= iov->iov_len;
+		if (cnt > 0) {
+			iov->iov_base = (char *)iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+
+	return (sz);
+}
+
+/* Only sockets of the generic kind can gather and coalesce */
+static int
+flowop_iov_check(flowop_t *f)
+{
+	char msg[1024];
+
+	if (f->connection->type == PROTOCOL_TCP ||
+	    f->connection->type == PROTOCOL_VSOCK)
+		return (0);
+	snprintf(msg, sizeof (msg), "flowop %s: iov and coalesce need a tcp "
+	    "or vsock connection", f->name);
+	uperf_log_msg(UPERF_LOG_ERROR, 0, msg);
+	errno = EPROTONOSUPPORT;
+
+	return (-1);
+}
+
+/*
+ * iov=N: N messages of size bytes each, from the next N buffers of
+ * the pool, moved by a single writev/readv as far as the socket
+ * allows.
+ */
+static int
+flowop_rwv(strand_t *s, flowop_t *f, int out)
+{
+	struct iovec iov[FLOWOP_IOV_MAX];
+	int i;
+
+	if (flowop_iov_check(f) != 0)
+		return (-1);
+	for (i = 0; i < f->options.iov; i++) {
+		iov[i].iov_base = BUFPOOL_NEXT(&s->pool);
+		iov[i].iov_len = f->options.size;
+	}
+
+	return (flowop_iov_fully(s, f, out, iov, f->options.iov, 0));
+}
+
+/*
+ * Payload size of the reply a request written by f asks for: the
+ * size of the next read in the txn, if there is one.
+ */
+static uint32_t
+frame_reply_size(strand_t *s, flowop_t *f)
+{
+	flowop_options_t *o;
+
+	for (f = f->next; f; f = f->next) {
+		if (f->type != FLOWOP_READ && f->type != FLOWOP_RECV)
+			continue;
+		o = &f->options;
+		if (FO_RANDOM_SIZE(o))
+			return (flowop_random_size(s, f));
+		return (o->size);
+	}
+
+	return (0);
+}
+
+static int
+frame_error(flowop_t *f, const char *what, uint32_t a, uint32_t b)
+{
+	char msg[1024];
+
+	snprintf(msg, sizeof (msg), "flowop %s: %s (%u, %u)", f->name, what,
+	    a, b);
+	uperf_log_msg(UPERF_LOG_ERROR, 0, msg);
+	errno = EPROTO;
+
+	return (-1);
+}
+
+/* Send one framed message of len payload bytes */
+static int
+frame_send(strand_t *s, flowop_t *f, flowop_rw_execute func, uint32_t len,
+    uint32_t id, uint32_t rlen)
+{
+	frame_hdr_t *h = (frame_hdr_t *)s->buffer;
+	uint32_t max = s->bufsize - sizeof (frame_hdr_t);
+	int n;
+
+	if (len > max)
+		return (frame_error(f, "message too large", len, max));
+	h->len = htonl(len);
+	h->id = htonl(id);
+	h->rlen = htonl(rlen);
+	if (touch_data(s, f->options.touch, s->buffer + sizeof (frame_hdr_t),
+	    len, 1) != UPERF_SUCCESS)
+		return (-1);
+	if (FO_VERIFY(&f->options))
+		(void) verify_data(f, s->buffer + sizeof (frame_hdr_t), len, id,
+		    1);
+	n = flowop_rw_fully(s, f, func, s->buffer, sizeof (frame_hdr_t) + len,
+	    0);
+
+	return (n < 0 ? -1 : len);
+}
+
+/*
+ * Receive one framed message. A reply must match the oldest request
+ * outstanding; a request is remembered so that the next write can
+ * answer it. Returns the payload size, or -1.
+ */
+static int
+frame_recv(strand_t *s, flowop_t *f, flowop_rw_execute func)
+{
+	protocol_t *p = f->connection;
+	frame_hdr_t *h = (frame_hdr_t *)s->buffer;
+	int datagram = (p->type == PROTOCOL_UDP || p->type == PROTOCOL_RDS);
+	uint32_t max = s->bufsize - sizeof (frame_hdr_t);
+	uint32_t len;
+	uint32_t id;
+	int n;
+
+	/* A datagram has to be read in one go */
+	n = flowop_rw_fully(s, f, func, s->buffer,
+	    datagram ? s->bufsize : sizeof (frame_hdr_t), datagram);
+	if (n < 0)
+		return (-1);
+	if (n < sizeof (frame_hdr_t))
+		return (frame_error(f, "short frame", n, sizeof (frame_hdr_t)));
+	len = ntohl(h->len);
+	id = ntohl(h->id);
+	if (len > max)
+		return (frame_error(f, "message too large", len, max));
+	if (p->frame_ackid != p->frame_txid) {
+		/* We have requests outstanding, so this is a reply */
+		if (id != ++p->frame_ackid)
+			return (frame_error(f, "reply out of order", id,
+			    p->frame_ackid));
+	} else {
+		p->frame_rxid = id;
+		p->frame_rlen = ntohl(h->rlen);
 	}
+	if (datagram) {
+		if (n != sizeof (frame_hdr_t) + len)
+			return (frame_error(f, "truncated frame", n,
+			    sizeof (frame_hdr_t) + len));
+	} else if (len > 0) {
+		n = flowop_rw_fully(s, f, func,
+		    s->buffer + sizeof (frame_hdr_t), len, 0);
+		if (n < 0)
+			return (-1);
+	}
+	if (FO_VERIFY(&f->options) &&
+	    verify_data(f, s->buffer + sizeof (frame_hdr_t), len, id, 0) != 0)
+		return (-1);
+	if (touch_data(s, f->options.touch, s->buffer + sizeof (frame_hdr_t),
+	    len, 0) != UPERF_SUCCESS)
+		return (-1);
+
+	return (len);
+}
+
+/* Answer the request received last, if it asked for a reply */
+static int
+frame_reply(strand_t *s, flowop_t *f, flowop_rw_execute func)
+{
+	protocol_t *p = f->connection;
+	uint32_t len = p->frame_rlen;
+
+	p->frame_rlen = 0;
+
+	return (frame_send(s, f, func, len, p->frame_rxid, 0));
+}
 
+/*
+ * Framed read or write: exactly one message, see frame_hdr_t. A write
+ * that follows a request is the reply to it, sized and numbered from
+ * the request's header; any other write is a new request. Replies
+ * must come back in the order the requests were sent. Returns the
+ * payload size, or -1.
+ */
+static int
+flowop_rw_framed(strand_t *s, flowop_t *f, flowop_rw_execute func)
+{
+	protocol_t *p = f->connection;
+
+	if (f->type != FLOWOP_WRITE && f->type != FLOWOP_SEND)
+		return (frame_recv(s, f, func));
+	if (p->frame_rlen > 0)
+		return (frame_reply(s, f, func));
+
+	return (frame_send(s, f, func, f->options.size, ++p->frame_txid,
+	    frame_reply_size(s, f)));
+}
+
+/*
+ * Bind f to its connection and to the connection's function for f's
+ * type. Connect, accept and disconnect unbind the flowops after them.
+ */
+static protocol_t *
+flowop_get_connection(strand_t *s, flowop_t *f)
+{
+	protocol_t *p;
+
+	if (f->connection != NULL)
+		return (f->connection);
+	if ((p = strand_get_connection(s, f->p_id)) == NULL) {
+		char msg[1024];
+		snprintf(msg, sizeof(msg), "No such connection %d", f->p_id);
+		uperf_log_msg(UPERF_LOG_ERROR, 0, msg);
+		return (NULL);
+	}
+	if (FO_SINK(&f->options) && p->type != PROTOCOL_TCP &&
+	    p->type != PROTOCOL_UDP) {
+		char msg[1024];
+		snprintf(msg, sizeof(msg), "flowop %s: sink needs a tcp or udp "
+		    "connection", f->name);
+		uperf_log_msg(UPERF_LOG_ERROR, 0, msg);
+		return (NULL);
+	}
 	if (f->type == FLOWOP_READ)
-		func = f->connection->read;
+		f->io = p->read;
 	else if (f->type == FLOWOP_WRITE)
-		func = f->connection->write;
+		f->io = p->write;
 	else if (f->type == FLOWOP_SEND)
-		func = f->connection->send;
+		f->io = p->send;
 	else if (f->type == FLOWOP_RECV)
-		func = f->connection->recv;
+		f->io = p->recv;
+	else
+		f->io = NULL;
+	f->connection = p;
+
+	return (p);
+}
+
+static int
+flowop_rw(strand_t *s, flowop_t *f)
+{
+	int sz;
+	uint64_t spin;
+	uint64_t calls;
+	uint64_t touch;
+	flowop_rw_execute func;
+	flowop_options_t *fo = &f->options;
+	int tx = (f->type == FLOWOP_WRITE || f->type == FLOWOP_SEND);
+
+	if (flowop_get_connection(s, f) == NULL)
+		return (-1);
+	func = f->io;
 
 	/* We only use rand_sz-* on transmit; fallback to rand_sz_max on rx */
 	if (FO_RANDOM_SIZE(fo)) {
 		if ((f->type == FLOWOP_WRITE) || (f->type == FLOWOP_SEND)) {
-			fo->size = my_random(fo->rand_sz_min, fo->rand_sz_max);
+			fo->size = flowop_random_size(s, f);
 		} else {
 			fo->size = fo->rand_sz_max;
 		}
@@ -109,34 +429,264 @@ flowop_rw(strand_t *s, flowop_t *f)
 		return (-1);
 	}
 	assert(fo->size > 0);
-	sz = 0;
-	while (sz < fo->size) {
-		if (SIGNALLED(s))
+	s->buffer = BUFPOOL_NEXT(&s->pool);
+	spin = f->connection->spin_time;
+	calls = f->connection->syscalls;
+	touch = s->touch_time;
+	if (fo->iov > 1) {
+		sz = flowop_rwv(s, f, tx);
+	} else if (FO_FRAMED(fo)) {
+		sz = flowop_rw_framed(s, f, func);
+	} else {
+		if (tx && touch_data(s, fo->touch, s->buffer, fo->size, 1) !=
+		    UPERF_SUCCESS)
 			return (-1);
-		n = func(f->connection, s->buffer + sz, fo->size - sz, fo);
-		/*
-		 * read(2) and write(2) can return 0 in case of a
-		 * hangup. For this case, we just assume that the
-		 * duration has expired and return
-		 */
-		if (n == 0) {
-			errno = EINTR;
+		if (tx && FO_VERIFY(fo))
+			(void) verify_data(f, s->buffer, fo->size, 0, 1);
+		sz = flowop_rw_fully(s, f, func, s->buffer, fo->size,
+		    FO_RANDOM_SIZE(fo));
+		/* The pattern only moves on by what was actually sent */
+		if (tx && FO_VERIFY(fo) && sz < (int)fo->size)
+			f->connection->verify_tx -= fo->size - MAX(sz, 0);
+		if (!tx && sz > 0 && FO_VERIFY(fo) &&
+		    verify_data(f, s->buffer, sz, 0, 0) != 0)
+			return (-1);
+		if (!tx && sz > 0 &&
+		    touch_data(s, fo->touch, s->buffer, sz, 0) != UPERF_SUCCESS)
 			return (-1);
+	}
+	if (sz < 0)
+		return (-1);
+	if (f->stats != NULL && stats_measured(FLOWOP_END, s, f->stats)) {
+		f->stats->spin_time += f->connection->spin_time - spin;
+		f->stats->syscalls += f->connection->syscalls - calls;
+		f->stats->touch_time += s->touch_time - touch;
+	}
+
+	return (sz);
+}
+
+/*
+ * flowop_rw() for a fixed size read or write that neither frames,
+ * touches nor verifies its data: all that is left to do per op is the
+ * I/O itself.
+ */
+static int
+flowop_rw_plain(strand_t *s, flowop_t *f)
+{
+	protocol_t *p = f->connection;
+	uint64_t spin;
+	uint64_t calls;
+	int sz;
+
+	if (p == NULL || f->io == NULL)
+		return (flowop_rw(s, f));
+	s->buffer = BUFPOOL_NEXT(&s->pool);
+	spin = p->spin_time;
+	calls = p->syscalls;
+	sz = flowop_rw_fully(s, f, f->io, s->buffer, f->options.size, 0);
+	if (sz > 0 && f->stats != NULL &&
+	    stats_measured(FLOWOP_END, s, f->stats)) {
+		f->stats->spin_time += p->spin_time - spin;
+		f->stats->syscalls += p->syscalls - calls;
+	}
+
+	return (sz);
+}
+
+/*
+ * count repetitions of a write or send with coalesce=, done at once.
+ * sendmsg gathers up to FLOWOP_IOV_MAX of them into every call, more
+ * sends each but the last with MSG_MORE, and cork sends them between
+ * setting TCP_CORK and clearing it. *done is set to the repetitions
+ * sent. Returns the size of one, or -1.
+ */
+int
+flowop_coalesce(strand_t *s, flowop_t *f, uint64_t count, uint64_t *done)
+{
+	struct iovec iov[FLOWOP_IOV_MAX];
+	flowop_options_t *fo = &f->options;
+	protocol_t *p;
+	uint64_t spin;
+	uint64_t calls;
+	uint64_t i = 0;
+	int error = 0;
+	int flags;
+	int j, n;
+
+	*done = 0;
+	if ((p = flowop_get_connection(s, f)) == NULL ||
+	    flowop_iov_check(f) != 0)
+		return (-1);
+	spin = p->spin_time;
+	calls = p->syscalls;
+	if (fo->coalesce == COALESCE_CORK && generic_cork(p, 1) != 0) {
+		flowop_rw_error(f);
+		return (-1);
+	}
+	while (i < count && error == 0) {
+		if (i > 0 && SIGNALLED(s)) {
+			errno = EINTR;
+			error = -1;
+			break;
 		}
-		if (n <= 0) {
-			if (errno != EINTR) {
-				int serrno = errno;
-				char msg[1024];
-				snprintf(msg, sizeof(msg), "Error for flowop %s ", f->name);
-				uperf_log_msg(UPERF_LOG_ERROR, serrno, msg);
-				/* snprintf could change errno */
-				errno = serrno;
-			}
+		n = 1;
+		if (fo->coalesce == COALESCE_SENDMSG)
+			n = MIN(count - i, FLOWOP_IOV_MAX);
+		for (j = 0; j < n; j++) {
+			iov[j].iov_base = BUFPOOL_NEXT(&s->pool);
+			iov[j].iov_len = fo->size;
+		}
+		flags = 0;
+		if (fo->coalesce == COALESCE_MORE && i + n < count)
+			flags = MSG_MORE;
+		if (flowop_iov_fully(s, f, 1, iov, n, flags) < 0)
+			error = -1;
+		else
+			i += n;
+	}
+	if (fo->coalesce == COALESCE_CORK && generic_cork(p, 0) != 0 &&
+	    error == 0) {
+		flowop_rw_error(f);
+		error = -1;
+	}
+	*done = i;
+	if (f->stats != NULL && stats_measured(FLOWOP_END, s, f->stats)) {
+		f->stats->spin_time += p->spin_time - spin;
+		f->stats->syscalls += p->syscalls - calls;
+	}
+
+	return (error == 0 ? fo->size : -1);
+}
+
+/*
+ * Wait for duration nsecs, but not past the end of a duration txn.
+ * The time actually waited goes to *actual. Returns -1 with errno
+ * set to EINTR if the txn is over.
+ */
+static int
+flowop_delay(strand_t *s, flowop_options_t *fo, uint64_t *duration,
+    hrtime_t *actual)
+{
+	hrtime_t start = GETHRTIME();
+
+	if (s->deadline != 0)
+		*duration = s->deadline > start ?
+		    MIN(*duration, s->deadline - start) : 0;
+	if (FO_THINK_BUSY(fo)) {
+		(void) uperf_spin(*duration);
+		*actual = GETHRTIME() - start;
+	} else {
+		(void) uperf_delay(*duration, fo->spin, actual);
+	}
+	if (SIGNALLED(s)) {
+		errno = EINTR;
+		return (-1);
+	}
+
+	return (0);
+}
+
+/*
+ * The master's side of a replay: the next message of the trace.
+ * Messages the master sends are delayed by their gap; the gap before
+ * a message it receives is the peer's to take. A read following a
+ * write is asked for in the write's header, any other read with an
+ * empty request.
+ */
+static int
+replay_master(strand_t *s, flowop_t *f)
+{
+	protocol_t *p = f->connection;
+	flowop_options_t *fo = &f->options;
+	trace_cursor_t *c = f->cursor;
+	trace_record_t r, next;
+	uint64_t gap;
+	hrtime_t slept;
+	uint32_t rlen = 0;
+	uint32_t id = 0;
+
+	trace_next(c, &r);
+	if (r.dir == TRACE_READ) {
+		if (!c->requested &&
+		    frame_send(s, f, p->write, 0, ++p->frame_txid, r.size) < 0)
 			return (-1);
+		c->requested = 0;
+		return (frame_recv(s, f, p->read));
+	}
+
+	gap = r.gap * fo->scale / 1000;
+	if (gap > 0 && flowop_delay(s, fo, &gap, &slept) != 0)
+		return (-1);
+	trace_peek(c, &next);
+	if (next.dir == TRACE_READ) {
+		rlen = next.size;
+		id = ++p->frame_txid;
+		c->requested = 1;
+	}
+
+	return (frame_send(s, f, p->write, r.size, id, rlen));
+}
+
+/*
+ * The slave's side of a replay: answer whatever the master asks for.
+ * A reply to a request that carried data stands for the master's next
+ * replay too, so that execution has nothing left to do.
+ */
+static int
+replay_slave(strand_t *s, flowop_t *f)
+{
+	protocol_t *p = f->connection;
+	int n, sz;
+
+	if (p->frame_skip) {
+		p->frame_skip = 0;
+		return (0);
+	}
+	if ((n = frame_recv(s, f, p->read)) < 0)
+		return (-1);
+	if (p->frame_rlen == 0)
+		return (n);
+	p->frame_skip = (n > 0);
+	if ((sz = frame_reply(s, f, p->write)) < 0)
+		return (-1);
+
+	return (n + sz);
+}
+
+int
+flowop_replay(strand_t *s, flowop_t *f)
+{
+	flowop_options_t *fo = &f->options;
+	uint64_t spin;
+	uint64_t calls;
+	int shard = 0;
+	int nshards = 1;
+	int sz;
+
+	if (flowop_get_connection(s, f) == NULL)
+		return (-1);
+	if (s->role == MASTER && f->cursor == NULL) {
+		if (FO_REPLAY_SHARD(fo)) {
+			shard = s->sid;
+			nshards = s->worklist->nthreads;
 		}
-		sz += n;
-		if (FO_RANDOM_SIZE(fo))
-			break;
+		if ((f->cursor = trace_cursor(f->trace, shard, nshards))
+		    == NULL)
+			return (-1);
+	}
+
+	spin = f->connection->spin_time;
+	calls = f->connection->syscalls;
+	if (s->role == MASTER)
+		sz = replay_master(s, f);
+	else
+		sz = replay_slave(s, f);
+	if (sz < 0)
+		return (-1);
+	if (f->stats != NULL && stats_measured(FLOWOP_END, s, f->stats)) {
+		f->stats->spin_time += f->connection->spin_time - spin;
+		f->stats->syscalls += f->connection->syscalls - calls;
 	}
 
 	return (sz);
@@ -172,8 +722,10 @@ flowop_connect(strand_t *sp, flowop_t *fp)
 	datap->p_id = fp->p_id;
 
 	error = datap->connect(datap, &fp->options);
+	if (error == UPERF_SUCCESS &&
+	    strand_add_connection(sp, datap) != 0)
+		error = UPERF_FAILURE;
 	if (error == UPERF_SUCCESS) {
-		strand_add_connection(sp, datap);
 		/* mark following flowops in this txn that they need to get a new connection */
 		for (flowop_t *fp1 = fp; fp1 != NULL; fp1 = fp1->next) {
 			fp1->connection = NULL;
@@ -221,13 +773,18 @@ flowop_accept(strand_t *sp, flowop_t *fp)
 	assert(cntrp != NULL);
 	assert(cntrp->accept != NULL);
 
+	cntrp->deadline = sp->deadline;
 	newp = cntrp->accept(cntrp, &fp->options);
 
 	if (newp == NULL) {
 		return (-1);
 	}
 	newp->p_id = fp->p_id;
-	strand_add_connection(sp, newp);
+	if (strand_add_connection(sp, newp) != 0) {
+		destroy_protocol(newp->type, newp);
+		return (-1);
+	}
+	sp->accepts++;
 
 	/* mark following flowops in this txn that they need to get a new connection */
 	for (flowop_t *fp1 = fp; fp1 != NULL; fp1 = fp1->next) {
@@ -251,6 +808,8 @@ flowop_sendfilev(strand_t *s, flowop_t *f)
 		}
 	}
 
+	/* sendfile(2) honours SO_SNDTIMEO, but not the deadline */
+	generic_clear_timeout(f->connection, f->connection->fd, SO_SNDTIMEO);
 	if (f->type == FLOWOP_SENDFILEV)
 #ifdef HAVE_SENDFILEV
 		n = do_sendfilev(f->connection->fd, f->options.dir,
@@ -277,17 +836,52 @@ int
 flowop_think(strand_t *sp, flowop_t *fp)
 {
 	int error;
+	hrtime_t actual;
+	uint64_t duration;
 	flowop_options_t *fo = &fp->options;
-	uperf_info("thinking for %.2fms\n", 1.0*fp->options.duration/1.0e+6);
-	if (FO_THINK_BUSY(fo)) {
-		error = uperf_spin(fp->options.duration);
-	} else {
-		error = uperf_sleep(fp->options.duration);
+
+	duration = fp->dist ? dist_sample(fp->dist, &sp->rng) : fo->duration;
+	uperf_info("thinking for %.2fms\n", 1.0*duration/1.0e+6);
+	error = flowop_delay(sp, fo, &duration, &actual);
+	if (fp->stats != NULL && stats_measured(FLOWOP_END, sp, fp->stats)) {
+		fp->stats->think_req += duration;
+		fp->stats->think_time += actual;
 	}
 
 	return (error);
 }
 
+/*
+ * Do the CPU work of a compute flowop: size bytes of it, or as much as
+ * takes duration on an idle CPU of this host (see compute.c).
+ */
+int
+flowop_compute(strand_t *sp, flowop_t *fp)
+{
+	flowop_options_t *fo = &fp->options;
+	uint64_t bytes;
+	hrtime_t start;
+
+	if (fp->work == NULL &&
+	    (fp->work = compute_init(fo->kernel, fo->wss)) == NULL)
+		return (-1);
+	if (fo->duration > 0)
+		bytes = (fp->dist ? dist_sample(fp->dist, &sp->rng) :
+		    fo->duration) * 1000 / MAX(fo->cost, 1);
+	else if (FO_RANDOM_SIZE(fo))
+		bytes = flowop_random_size(sp, fp);
+	else
+		bytes = fo->size;
+	start = GETHRTIME();
+	compute_run(fp->work, fo->kernel, bytes);
+	if (fp->stats != NULL && stats_measured(FLOWOP_END, sp, fp->stats)) {
+		fp->stats->compute_req += bytes * fo->cost / 1000;
+		fp->stats->compute_time += GETHRTIME() - start;
+	}
+
+	return (0);
+}
+
 /* ARGSUSED */
 int
 flowop_unknown(strand_t *st, flowop_t *fp)
@@ -330,7 +924,30 @@ flowop_get_execute_func(int type)
 	case FLOWOP_SENDFILE:
 		func = &flowop_sendfilev;
 		break;
+	case FLOWOP_REPLAY:
+		func = &flowop_replay;
+		break;
+	case FLOWOP_COMPUTE:
+		func = &flowop_compute;
+		break;
 	}
 
 	return (func);
 }
+
+/*
+ * The function that runs f in an execution plan: flowop_rw_plain()
+ * for reads and writes that need none of flowop_rw()'s options,
+ * f->execute for everything else.
+ */
+execute_func
+flowop_plan_execute_func(flowop_t *f)
+{
+	flowop_options_t *fo = &f->options;
+
+	if (f->execute != &flowop_rw || FO_FRAMED(fo) || FO_RANDOM_SIZE(fo) ||
+	    FO_VERIFY(fo) || fo->touch != TOUCH_NONE || fo->iov > 1)
+		return (f->execute);
+
+	return (&flowop_rw_plain);
+}
@@ -18,13 +18,27 @@
 #ifndef FLOWOPS_LIBARARY_H
 #define FLOWOPS_LIBARARY_H
 
+/*
+ * Header in front of every framed message (option "framed"), in
+ * network byte order.
+ */
+typedef struct frame_hdr {
+	uint32_t len;	/* Payload bytes following the header */
+	uint32_t id;	/* Request id; a reply carries its request's */
+	uint32_t rlen;	/* Payload size wanted in the reply */
+} frame_hdr_t;
+
 int flowop_think(strand_t *, flowop_t *);
+int flowop_compute(strand_t *, flowop_t *);
 int flowop_read(strand_t *, flowop_t *);
 int flowop_write(strand_t *, flowop_t *);
 int flowop_unknown(strand_t *, flowop_t *);
 int flowop_accept(strand_t *, flowop_t *);
 int flowop_disconnect(strand_t *, flowop_t *);
 int flowop_connect(strand_t *, flowop_t *);
+int flowop_replay(strand_t *, flowop_t *);
 execute_func flowop_get_execute_func(int);
+execute_func flowop_plan_execute_func(flowop_t *);
+int flowop_coalesce(strand_t *, flowop_t *, uint64_t, uint64_t *);
 
 #endif /* FLOWOPS_LIBARARY_H */
@@ -44,7 +44,9 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/time.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 
 #ifdef  HAVE_SYS_POLL_H
@@ -60,6 +62,8 @@
 #define	USE_POLL_ACCEPT	1
 #define	LISTENQ		10240	/* 2nd argument to listen() */
 #define	TIMEOUT		1200000	/* Argument to poll */
+#define	ACCEPT_TIMEOUT	10000000000ULL	/* nsecs to wait in accept */
+#define	DEADLINE_SLICE	10000000ULL	/* nsecs I/O blocks in a duration txn */
 
 int
 name_to_addr(const char *address, struct sockaddr_storage *saddr)
@@ -205,9 +209,11 @@ generic_verify_socket_buffer(int fd, int wndsz)
 int
 generic_listen(protocol_t *p, int pflag, void* options)
 {
+	flowop_options_t *fo = (flowop_options_t *)options;
 	const int on = 1;
 	const int off = 0;
 	int use_ipv6_socket;
+	int backlog;
 	socklen_t len;
 
 	if (setsockopt(p->fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(int)) < 0) {
@@ -219,6 +225,23 @@ generic_listen(protocol_t *p, int pflag, void* options)
 	} else {
 		use_ipv6_socket = 1;
 	}
+	if (fo != NULL && FO_REUSEPORT(fo)) {
+#ifdef SO_REUSEPORT
+		if (setsockopt(p->fd, SOL_SOCKET, SO_REUSEPORT, &on,
+		    sizeof (int)) < 0) {
+			ulog_err("%s: Cannot set SO_REUSEPORT",
+			    protocol_to_str(p->type));
+			return (UPERF_FAILURE);
+		}
+		/* A shard of its own: accept first, poll once it is empty */
+		if (generic_setfd_nonblock(p->fd) == 0)
+			p->nonblock = 1;
+#else
+		uperf_log_msg(UPERF_LOG_ERROR, 0,
+		    "SO_REUSEPORT is not supported on this platform");
+		return (UPERF_FAILURE);
+#endif /* SO_REUSEPORT */
+	}
 	if (use_ipv6_socket) {
 		struct sockaddr_in6 sin6;
 
@@ -268,7 +291,12 @@ generic_listen(protocol_t *p, int pflag, void* options)
 			}
 		}
 	}
-	listen(p->fd, LISTENQ);
+	backlog = (fo != NULL && fo->backlog > 0) ? fo->backlog : LISTENQ;
+	if (listen(p->fd, backlog) < 0) {
+		ulog_err("%s: Cannot listen on port %d",
+		    protocol_to_str(p->type), p->port);
+		return (UPERF_FAILURE);
+	}
 	uperf_debug("Listening on port %d\n", p->port);
 
 	return (p->port);
@@ -299,46 +327,355 @@ generic_disconnect(protocol_t *p)
 	if (p && p->fd >= 0) {
 		(void) close(p->fd);
 		p->fd = -1;
+		p->rcvtimeo = p->sndtimeo = 0;
 	}
 
 	return (UPERF_SUCCESS);
 }
 
+/*
+ * Spin on a non-blocking recv for at most fo->spin nsecs. The time
+ * burnt before data shows up is charged to p->spin_time. Returns -1
+ * with errno set to EAGAIN if the budget ran out.
+ */
+static int
+generic_spin_read(protocol_t *p, void *buffer, int size,
+    flowop_options_t *fo, int flags)
+{
+	hrtime_t start, now;
+	int n;
+
+	start = now = GETHRTIME();
+	do {
+		p->syscalls++;
+		n = recv(p->fd, buffer, size, flags | MSG_DONTWAIT);
+		if (n >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+			p->spin_time += now - start;
+			return (n);
+		}
+		now = GETHRTIME();
+	} while (now - start < fo->spin);
+	p->spin_time += now - start;
+	errno = EAGAIN;
+
+	return (-1);
+}
+
+/*
+ * poll_timeout handling. Instead of a poll(2) in front of every
+ * read, a blocking socket gets the timeout installed once as
+ * SO_RCVTIMEO/SO_SNDTIMEO and the kernel enforces it inside the read
+ * itself; the option is only touched again if the timeout changes.
+ * A non-blocking socket is read first and polled only on EAGAIN.
+ *
+ * A timeout of 0 removes a previously installed one. Returns 0 if the
+ * caller can go straight to the syscall and -1 if the timeout could
+ * not be handed to the kernel, in which case the caller has to poll
+ * before the syscall.
+ */
+int
+generic_set_timeout(protocol_t *p, int fd, int optname, uint64_t timeout)
+{
+	uint64_t *cur = (optname == SO_RCVTIMEO) ? &p->rcvtimeo : &p->sndtimeo;
+	struct timeval tv;
+	int flags;
+
+	if (*cur == timeout)
+		return (0);
+	if (p->rcvtimeo == 0 && p->sndtimeo == 0) {
+		flags = fcntl(fd, F_GETFL);
+		p->nonblock = (flags != -1 && (flags & O_NONBLOCK));
+		p->syscalls++;
+	}
+	if (p->nonblock) {
+		*cur = timeout;
+		return (0);
+	}
+	tv.tv_sec = timeout / 1000000000ULL;
+	tv.tv_usec = (timeout % 1000000000ULL) / 1000;
+	if (timeout > 0 && tv.tv_sec == 0 && tv.tv_usec == 0)
+		tv.tv_usec = 1;		/* 0 would mean "no timeout" */
+	p->syscalls++;
+	if (setsockopt(fd, SOL_SOCKET, optname, &tv, sizeof (tv)) != 0) {
+		ulog_warn("Cannot set %s",
+		    optname == SO_RCVTIMEO ? "SO_RCVTIMEO" : "SO_SNDTIMEO");
+		return (-1);
+	}
+	*cur = timeout;
+
+	return (0);
+}
+
+/*
+ * Called after an I/O syscall failed with EAGAIN under a timeout.
+ * On a blocking socket the kernel has already waited for the full
+ * timeout. Returns 0 if the syscall should be retried, -1 otherwise.
+ */
+int
+generic_timeout_wait(protocol_t *p, int fd, int timeout, short poll_type)
+{
+	if (!p->nonblock) {
+		errno = ETIMEDOUT;
+		return (-1);
+	}
+	p->syscalls++;
+	if (generic_poll(fd, timeout, poll_type) <= 0) {
+		errno = ETIMEDOUT;
+		return (-1);
+	}
+
+	return (0);
+}
+
+/* Like generic_poll(), but timeout is in nsecs */
+static int
+generic_poll_nsecs(int fd, uint64_t timeout, short poll_type)
+{
+	struct pollfd pfd;
+#ifdef HAVE_PPOLL
+	struct timespec ts;
+#endif /* HAVE_PPOLL */
+
+	pfd.fd = fd;
+	pfd.events = poll_type;
+	pfd.revents = 0;
+#ifdef HAVE_PPOLL
+	ts.tv_sec = timeout / 1000000000ULL;
+	ts.tv_nsec = timeout % 1000000000ULL;
+	return (ppoll(&pfd, 1, &ts, NULL));
+#else
+	return (poll(&pfd, 1, (timeout + 999999) / 1000000));
+#endif /* HAVE_PPOLL */
+}
+
+/* Outside a duration txn, a call blocks for as long as it takes */
+void
+generic_clear_timeout(protocol_t *p, int fd, int optname)
+{
+	if ((optname == SO_RCVTIMEO ? p->rcvtimeo : p->sndtimeo) != 0)
+		(void) generic_set_timeout(p, fd, optname, 0);
+}
+
+/*
+ * I/O in a duration txn must not block past p->deadline. The syscall
+ * blocks as usual, but the kernel gives up on it after DEADLINE_SLICE,
+ * or timeout if that is shorter: the slice is installed as optname
+ * (SO_RCVTIMEO/SO_SNDTIMEO) once and then left alone, so a call costs
+ * no extra syscall, and one that has to wait one more per slice. Where
+ * the kernel cannot time the call out, it is made with MSG_DONTWAIT
+ * and generic_deadline_wait() polls instead. Returns the flags for the
+ * syscall.
+ */
+int
+generic_deadline_flags(protocol_t *p, int fd, int optname, uint64_t timeout)
+{
+	uint64_t slice = DEADLINE_SLICE;
+
+	if (timeout > 0)
+		slice = MIN(slice, timeout);
+	if (generic_set_timeout(p, fd, optname, slice) != 0 || p->nonblock)
+		return (MSG_DONTWAIT);
+
+	return (0);
+}
+
+/*
+ * Called when a syscall made with generic_deadline_flags() (flags)
+ * failed with EAGAIN or EINTR. A blocking call has waited for a slice
+ * already; for one with MSG_DONTWAIT this polls for no longer than the
+ * time left, or than what is left of timeout (nsecs since start) if
+ * that runs out first. Returns 0 if the syscall should be retried, or
+ * -1 with errno set to EINTR once the deadline has passed, just like a
+ * call a signal interrupted.
+ */
+int
+generic_deadline_wait(protocol_t *p, int fd, hrtime_t start,
+    uint64_t timeout, short poll_type, int flags)
+{
+	hrtime_t now = GETHRTIME();
+	uint64_t wait;
+
+	if (now >= p->deadline) {
+		errno = EINTR;
+		return (-1);
+	}
+	wait = p->deadline - now;
+	if (timeout > 0) {
+		if (now - start >= timeout) {
+			errno = ETIMEDOUT;
+			return (-1);
+		}
+		wait = MIN(wait, timeout - (now - start));
+	}
+	if ((flags & MSG_DONTWAIT) == 0)
+		return (0);
+	p->syscalls++;
+	if (generic_poll_nsecs(fd, wait, poll_type) < 0 && errno != EINTR)
+		return (-1);
+
+	return (0);
+}
+
+/*
+ * The flags of a read with option sink: Linux then drops TCP data
+ * instead of copying it out. Elsewhere the data is read as usual.
+ */
+#if defined(__linux__) && defined(MSG_TRUNC)
+#define	GENERIC_SINK(fo)	((fo) != NULL && FO_SINK(fo) ? MSG_TRUNC : 0)
+#else
+#define	GENERIC_SINK(fo)	0
+#endif
+
+/* read/recv (out == 0) or write/send under p->deadline */
+static int
+generic_io_deadline(protocol_t *p, int out, void *buffer, int size,
+    uint64_t timeout, int flags)
+{
+	hrtime_t start = timeout > 0 ? GETHRTIME() : 0;
+	int n;
+
+	flags |= generic_deadline_flags(p, p->fd,
+	    out ? SO_SNDTIMEO : SO_RCVTIMEO, timeout);
+	for (;;) {
+		p->syscalls++;
+		if (out)
+			n = send(p->fd, buffer, size, flags);
+		else
+			n = recv(p->fd, buffer, size, flags);
+		if (n >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK &&
+		    errno != EINTR))
+			return (n);
+		if (generic_deadline_wait(p, p->fd, start, timeout,
+		    out ? POLLOUT : POLLIN, flags) != 0)
+			return (-1);
+	}
+}
+
 int
 generic_read(protocol_t *p, void *buffer, int size, void *options)
 {
 	flowop_options_t *fo = (flowop_options_t *)options;
 	int timeout = (fo ? fo->poll_timeout/1.0e+6 : 0);
-
-	if (timeout > 0) {
+	int flags = GENERIC_SINK(fo);
+	int n;
+
+	if (fo && fo->spin > 0) {
+		n = generic_spin_read(p, buffer, size, fo, flags);
+		if (n >= 0 || errno != EAGAIN)
+			return (n);
+		/* Budget exhausted, fall back to a blocking read */
+	}
+	if (p->deadline != 0)
+		return (generic_io_deadline(p, 0, buffer, size,
+		    timeout > 0 ? fo->poll_timeout : 0, flags));
+	if (generic_set_timeout(p, p->fd, SO_RCVTIMEO,
+	    timeout > 0 ? fo->poll_timeout : 0) != 0 && timeout > 0) {
+		p->syscalls++;
 		if ((generic_poll(p->fd, timeout, POLLIN)) <= 0)
 			return (-1);
 	}
-	return (read(p->fd, buffer, size));
+	for (;;) {
+		p->syscalls++;
+		if (flags != 0)
+			n = recv(p->fd, buffer, size, flags);
+		else
+			n = read(p->fd, buffer, size);
+		if (n >= 0 || timeout <= 0 ||
+		    (errno != EAGAIN && errno != EWOULDBLOCK))
+			return (n);
+		if (generic_timeout_wait(p, p->fd, timeout, POLLIN) != 0)
+			return (-1);
+	}
 }
 
 /* ARGSUSED */
 int
 generic_write(protocol_t *p, void *buffer, int size, void *options)
 {
+	if (p->deadline != 0)
+		return (generic_io_deadline(p, 1, buffer, size, 0, 0));
+	generic_clear_timeout(p, p->fd, SO_SNDTIMEO);
+	p->syscalls++;
 	return (write(p->fd, buffer, size));
 }
 
-/* ARGSUSED */
 int
 generic_recv(protocol_t *p, void *buffer, int size, void *options)
 {
-	return (recv(p->fd, buffer, size, 0));
+	int flags = GENERIC_SINK((flowop_options_t *)options);
+
+	if (p->deadline != 0)
+		return (generic_io_deadline(p, 0, buffer, size, 0, flags));
+	generic_clear_timeout(p, p->fd, SO_RCVTIMEO);
+	p->syscalls++;
+	return (recv(p->fd, buffer, size, flags));
 }
 
 /* ARGSUSED */
 int
 generic_send(protocol_t *p, void *buffer, int size, void *options)
 {
+	if (p->deadline != 0)
+		return (generic_io_deadline(p, 1, buffer, size, 0, 0));
+	generic_clear_timeout(p, p->fd, SO_SNDTIMEO);
+	p->syscalls++;
 	return (send(p->fd, buffer, size, 0));
 }
 
 
+/*
+ * sendmsg (out) or recvmsg of the iovcnt segments at iov in one
+ * syscall, under p->deadline like the calls above. flags can ask for
+ * MSG_MORE. Returns what the syscall moved, which can be less than
+ * all of the segments.
+ */
+int
+generic_iov(protocol_t *p, int out, struct iovec *iov, int iovcnt, int flags)
+{
+	struct msghdr msg;
+	int optname = out ? SO_SNDTIMEO : SO_RCVTIMEO;
+	int n;
+
+	bzero(&msg, sizeof (msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = iovcnt;
+	if (p->deadline != 0)
+		flags |= generic_deadline_flags(p, p->fd, optname, 0);
+	else
+		generic_clear_timeout(p, p->fd, optname);
+	for (;;) {
+		p->syscalls++;
+		if (out)
+			n = sendmsg(p->fd, &msg, flags);
+		else
+			n = recvmsg(p->fd, &msg, flags);
+		if (n >= 0 || p->deadline == 0 || (errno != EAGAIN &&
+		    errno != EWOULDBLOCK && errno != EINTR))
+			return (n);
+		if (generic_deadline_wait(p, p->fd, 0, 0,
+		    out ? POLLOUT : POLLIN, flags) != 0)
+			return (-1);
+	}
+}
+
+/*
+ * Hold back partial segments of a TCP connection until uncorked
+ * (TCP_NOPUSH where there is no TCP_CORK).
+ */
+int
+generic_cork(protocol_t *p, int on)
+{
+	p->syscalls++;
+#if defined(TCP_CORK)
+	return (setsockopt(p->fd, IPPROTO_TCP, TCP_CORK, &on, sizeof (on)));
+#elif defined(TCP_NOPUSH)
+	return (setsockopt(p->fd, IPPROTO_TCP, TCP_NOPUSH, &on, sizeof (on)));
+#else
+	errno = ENOTSUP;
+	return (-1);
+#endif
+}
+
 /* ARGSUSED */
 int
 generic_undefined(protocol_t *p, void *options)
@@ -347,12 +684,61 @@ generic_undefined(protocol_t *p, void *options)
 	return (UPERF_FAILURE);
 }
 
+/*
+ * Wait for a connection to come in, for ACCEPT_TIMEOUT nsecs since
+ * start and not past p->deadline. Returns 0 once there is one, or -1
+ * (errno is EINTR if the deadline has passed).
+ */
+static int
+generic_accept_wait(protocol_t *p, hrtime_t start)
+{
+	hrtime_t now;
+	uint64_t wait;
+	int n;
+
+	for (;;) {
+		now = GETHRTIME();
+		if (now - start >= ACCEPT_TIMEOUT)
+			return (-1);
+		wait = ACCEPT_TIMEOUT - (now - start);
+		if (p->deadline != 0) {
+			if (now >= p->deadline) {
+				errno = EINTR;
+				return (-1);
+			}
+			wait = MIN(wait, p->deadline - now);
+		}
+		if ((n = generic_poll_nsecs(p->fd, wait, POLLIN)) != 0)
+			return (n > 0 ? 0 : -1);
+	}
+}
+
+/*
+ * accept4() sets up the new socket in the same call. Where it has to
+ * be accept(), a non-blocking listener may pass O_NONBLOCK on to it.
+ */
+static int
+generic_accept_fd(protocol_t *p, struct sockaddr *sa, socklen_t *len)
+{
+	int fd;
+
+#ifdef HAVE_ACCEPT4
+	fd = accept4(p->fd, sa, len, SOCK_CLOEXEC);
+#else
+	fd = accept(p->fd, sa, len);
+	if (fd >= 0 && p->nonblock)
+		(void) fcntl(fd, F_SETFL, 0);
+#endif /* HAVE_ACCEPT4 */
+
+	return (fd);
+}
+
 /* ARGSUSED2 */
 int
 generic_accept(protocol_t *oldp, protocol_t *newp, void *options)
 {
 	socklen_t addrlen;
-	int timeout;
+	hrtime_t start;
 	char hostname[NI_MAXHOST];
 	struct sockaddr_storage remote;
 
@@ -360,15 +746,21 @@ generic_accept(protocol_t *oldp, protocol_t *newp, void *options)
 	assert(newp);
 
 	addrlen = (socklen_t)sizeof(struct sockaddr_storage);
-	timeout = 10000;
+	start = GETHRTIME();
 
-	if ((generic_poll(oldp->fd, timeout, POLLIN)) <= 0)
+	if (!oldp->nonblock && generic_accept_wait(oldp, start) != 0)
 		return (-1);
 
-	if ((newp->fd = accept(oldp->fd, (struct sockaddr *)&remote,
-	    &addrlen)) < 0) {
-		ulog_err("accept:");
-		return (UPERF_FAILURE);
+	while ((newp->fd = generic_accept_fd(oldp,
+	    (struct sockaddr *)&remote, &addrlen)) < 0) {
+		if (!oldp->nonblock || (errno != EAGAIN &&
+		    errno != EWOULDBLOCK)) {
+			ulog_err("accept:");
+			return (UPERF_FAILURE);
+		}
+		if (generic_accept_wait(oldp, start) != 0)
+			return (-1);
+		addrlen = (socklen_t)sizeof(struct sockaddr_storage);
 	}
 	switch (remote.ss_family) {
 	case AF_INET:
@@ -427,6 +819,33 @@ generic_fini(protocol_t *p)
 		free(p);
 }
 
+void
+set_busy_poll_options(int fd, flowop_options_t *f)
+{
+	if (f && f->busy_poll > 0) {
+#ifdef SO_BUSY_POLL
+		int usecs = f->busy_poll;
+		if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL,
+			(char *)&usecs, sizeof (usecs))) {
+			ulog_warn("Cannot set SO_BUSY_POLL:");
+		}
+#else
+		uperf_warn("Configuring busy polling not supported");
+#endif
+	}
+	if (f && FO_PREFER_BUSY_POLL(f)) {
+#ifdef SO_PREFER_BUSY_POLL
+		int on = 1;
+		if (setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL,
+			(char *)&on, sizeof (on))) {
+			ulog_warn("Cannot set SO_PREFER_BUSY_POLL:");
+		}
+#else
+		uperf_warn("Configuring preferred busy polling not supported");
+#endif
+	}
+}
+
 void
 set_tcp_options(int fd, flowop_options_t *f)
 {
@@ -491,4 +910,5 @@ set_tcp_options(int fd, flowop_options_t *f)
 		uperf_warn("Configuring TCP black box logging not supported");
 #endif
 	}
+	set_busy_poll_options(fd, f);
 }
@@ -23,6 +23,7 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <sys/uio.h>
 
 int name_to_addr(const char *, struct sockaddr_storage *);
 int generic_socket(protocol_t *, int, int);
@@ -38,7 +39,15 @@ int generic_set_socket_buffer(int, int);
 int generic_verify_socket_buffer(int, int);
 int generic_setfd_nonblock(int);
 int generic_poll(int, int, short);
+int generic_set_timeout(protocol_t *, int, int, uint64_t);
+int generic_timeout_wait(protocol_t *, int, int, short);
+void generic_clear_timeout(protocol_t *, int, int);
+int generic_deadline_flags(protocol_t *, int, int, uint64_t);
+int generic_deadline_wait(protocol_t *, int, hrtime_t, uint64_t, short, int);
 void set_tcp_options(int fd, flowop_options_t *f);
+void set_busy_poll_options(int fd, flowop_options_t *f);
 int generic_recv(protocol_t *p, void *buffer, int size, void *options);
 int generic_send(protocol_t *p, void *buffer, int size, void *options);
+int generic_iov(protocol_t *, int, struct iovec *, int, int);
+int generic_cork(protocol_t *, int);
 #endif /* _GENERIC_H */
@@ -36,6 +36,7 @@ typedef struct {
 #define	MESSAGE_WARNING	0xbb
 #define	MESSAGE_INFO	0xcc
 #define	MESSAGE_NONE	0xdd
+#define	MESSAGE_REPORT	0xee	/* Success, message has accept stats */
 
 #define	GOODBYE_MESSAGE_LEN 	512
 #define GOODBYE_MAGIC		"So Long, and Thanks for All the Fish"
@@ -70,7 +70,7 @@ static void
 uperf_usage(char *prog)
 {
 	(void) printf("Uperf Version %s\n", UPERF_VERSION);
-	(void) printf("Usage:   %s [-m profile] [-hvV] [-ngtTfkpaeE:X:i:P:RS:]\n",
+	(void) printf("Usage:   %s [-m profile] [-hvV] [-ngtTfkpaeE:X:i:b:c:B:r:P:RS:]\n",
 	    prog);
 	(void) printf("\t %s [-s] [-hvV]\n\n", prog);
 	(void) printf(
@@ -79,8 +79,8 @@ uperf_usage(char *prog)
 	"\t-S <protocol>\t Protocol type for the control Socket [def: tcp]\n"
 	"\t-n\t\t No statistics\n"
 	"\t-T\t\t Print Thread statistics\n"
-	"\t-t\t\t Print Transaction averages\n"
-	"\t-f\t\t Print Flowop averages\n"
+	"\t-t\t\t Print Transaction averages and percentiles\n"
+	"\t-f\t\t Print Flowop averages and percentiles\n"
 	"\t-g\t\t Print Group statistics\n"
 	"\t-k\t\t Collect kstat statistics\n"
 	"\t-p\t\t Collect CPU utilization for flowops [-f assumed]\n"
@@ -89,6 +89,10 @@ uperf_usage(char *prog)
 	"\t-a\t\t Collect all statistics\n"
 	"\t-X <file>\t Collect response times\n"
 	"\t-i <interval>\t Collect throughput every <interval>\n"
+	"\t-b <batch>\t Sample duration txns in batches of <batch>\n"
+	"\t-c <pct>\t End a txn once its 95%% CI is within <pct>%% [-b]\n"
+	"\t-B <file>\t Compare with baseline <file>, or create it [-f assumed]\n"
+	"\t-r <pct>\t Flag regressions worse than <pct>%% [def: 5]\n"
 	"\t-P <port>\t Set the master port (defaults to 20000)\n"
 	"\t-R\t\t Emit raw (not transformed), time-stamped (ms) statistics\n"
 	"\t-v\t\t Verbose\n"
@@ -159,11 +163,12 @@ init_options(int argc, char **argv)
 	options.copt |= PACKET_STATS;
 
 	options.interval = 1000;	/* Collect throughput every 1second */
+	options.regress_pct = 5.0;	/* Flag regressions beyond 5% */
 	options.master_port = MASTER_PORT;
 	options.control_proto = PROTOCOL_TCP;
 	oserver = oclient = ofile = 0;
 
-	while ((ch = getopt(argc, argv, "E:epTgtfknasm:X:i:P:S:RvVh")) != EOF) {
+	while ((ch = getopt(argc, argv, "E:epTgtfknasm:X:i:b:c:B:r:P:S:RvVh")) != EOF) {
 		switch (ch) {
 #ifdef USE_CPC
 		case 'E':
@@ -268,6 +273,28 @@ init_options(int argc, char **argv)
 				uperf_fatal("Please specify interval\n");
 			}
 			break;
+		case 'b':
+			options.batch = string_to_nsec(optarg);
+			if (options.batch == 0 || options.batch == (uint64_t)-1)
+				uperf_fatal("Incorrect batch: %s\n", optarg);
+			break;
+		case 'c':
+			options.ci_target = atof(optarg);
+			if (options.ci_target <= 0)
+				uperf_fatal("Incorrect CI target: %s\n",
+				    optarg);
+			break;
+		case 'B':
+			(void) strlcpy(options.baseline, optarg,
+			    sizeof (options.baseline));
+			options.copt |= FLOWOP_STATS;
+			break;
+		case 'r':
+			options.regress_pct = atof(optarg);
+			if (options.regress_pct <= 0)
+				uperf_fatal("Incorrect threshold: %s\n",
+				    optarg);
+			break;
 		case 'P':
 			if (optarg) {
 				options.master_port = (int)
@@ -320,6 +347,10 @@ init_options(int argc, char **argv)
 		uperf_error("Please specify profile for client.\n");
 		return (NULL);
 	}
+	if (options.ci_target > 0 && options.batch == 0) {
+		uperf_error("-c needs batches, please specify -b\n");
+		return (NULL);
+	}
 #ifdef ENABLE_NETSTAT
 	if (oclient && ENABLED_PACKET_STATS(options)) {
 		if (netstat_init() != 0) {
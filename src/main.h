@@ -70,6 +70,10 @@ typedef struct options {
 	char	*ev2;
 	uint32_t copt;	/* Collect options */
 	uint64_t interval;	/* collect stats every interval msecs */
+	uint64_t batch;		/* Batch length in nsecs (-b) */
+	double	ci_target;	/* End txns at this CI width in % (-c) */
+	char	baseline[PATH_MAX];	/* Baseline file (-B) */
+	double	regress_pct;	/* Regression threshold in % (-r) */
 	proto_type_t control_proto;
 }options_t;
 
@@ -60,6 +60,10 @@
 #include "netstat.h"
 #include "goodbye.h"
 #include "print.h"
+#include "batch.h"
+#include "baseline.h"
+#include "affinity.h"
+#include "compute.h"
 #include "signals.h"
 #include "common.h"
 #include "stats.h"
@@ -104,6 +108,8 @@ say_goodbye(goodbye_stat_t *total, protocol_t *p, int timeout)
 			break;
 	}
 	(void) print_goodbye_stat(p->host, &g.gstat);
+	if (g.msg_type == MESSAGE_REPORT)
+		(void) printf("%-15.15s %s\n", "", g.message);
 	total->elapsed_time = MAX(g.gstat.elapsed_time, total->elapsed_time);
 	total->error += g.gstat.error;
 	total->bytes_xfer += g.gstat.bytes_xfer;
@@ -174,15 +180,13 @@ group_assign_stat(uperf_shm_t *shm, group_t *g, uint32_t sid)
  * -1 : indicates error
  */
 static int
-poll_slaves()
+poll_slaves(int timeout)
 {
 	int i;
 	int error;
 	struct pollfd pfd[MAXSLAVES];
 	int no_pfds = no_slaves;
-	uint64_t timeout;
 
-	timeout = MIN(MAX_POLL_SLAVES_TIMEOUT, options.interval);
 	for (i = 0; i < no_slaves; i++) {
 		pfd[i].fd = slaves[i]->fd;
 		pfd[i].events = POLLIN;
@@ -229,17 +233,27 @@ master_prepare_to_exit(uperf_shm_t *shm)
 	cleaned_up++;
 }
 
+/* Progress of txn (index), which started when prev was taken */
 static void
-print_progress(uperf_shm_t *shm, newstats_t prev)
+print_progress(uperf_shm_t *shm, newstats_t prev, int txn)
 {
 	if (ENABLED_STATS(options)) {
 		newstats_t pns;
+		uint64_t from, to;
 		update_aggr_stat(shm);
 		(void) memcpy(&pns, AGG_STAT(shm), sizeof (pns));
 		pns.start_time = prev.end_time;
 		pns.size -= prev.size;
 		pns.end_time = GETHRTIME();
 		pns.count -= prev.count;
+		/* Rates are over the part of the txn that is measured */
+		if (txn >= 0 &&
+		    workorder_txn_window(shm->workorder, txn, &from, &to)) {
+			if (pns.end_time <= shm->txn_begin + from)
+				return;
+			pns.start_time = shm->txn_begin + from;
+			pns.end_time = MIN(pns.end_time, shm->txn_begin + to);
+		}
 		(void) strlcpy(pns.name, prev.name, sizeof (pns.name));
 		print_summary(&pns, 1);
 	}
@@ -251,9 +265,11 @@ master_poll(uperf_shm_t *shm)
 	int no_txn;
 	int error;
 	int curr_txn = 0;
+	int early;
 	barrier_t *curr_bar;
 	double time_to_print;
 	newstats_t prev_ns;
+	int timeout, batch;
 
 	bzero(&prev_ns, sizeof (prev_ns));
 
@@ -274,7 +290,15 @@ master_poll(uperf_shm_t *shm)
 		if (shm->global_error > 0) {
 			break;
 		}
-		error = poll_slaves();
+		/*
+		 * Wake up as soon as the strands reach the barrier, but
+		 * keep an eye on the slaves meanwhile.
+		 */
+		timeout = MIN(MAX_POLL_SLAVES_TIMEOUT, options.interval);
+		if ((batch = batch_poll(shm)) >= 0)
+			timeout = MIN(timeout, batch);
+		(void) barrier_wait_reached(curr_bar, timeout);
+		error = poll_slaves(0);
 		if (error != 0) {	/* msg arrived */
 			/* Read slave msg and process it */
 			(void) printf("\n*** Slave aborted! ***\n");
@@ -285,9 +309,11 @@ master_poll(uperf_shm_t *shm)
 		shm_process_callouts(shm);
 
 		if (BARRIER_REACHED(curr_bar)) { /* goto Next Txn */
+			early = batch_txn_end(shm, curr_txn - 1);
 			if (ENABLED_STATS(options)) {
 				if (curr_txn != 0) {
-					print_progress(shm, prev_ns);
+					print_progress(shm, prev_ns,
+					    curr_txn - 1);
 					(void) printf("\n");
 				}
 				update_aggr_stat(shm);
@@ -304,26 +330,29 @@ master_poll(uperf_shm_t *shm)
 			 * per group may not be the same
 			 */
 			(void) send_command_to_slaves(UPERF_CMD_NEXT_TXN,
-			    curr_txn);
+			    curr_txn | (early ? UPERF_TXN_EARLY : 0));
 			/* release barrier so master can also begin curr_txn */
 			shm->txn_begin = GETHRTIME();
 			unlock_barrier(curr_bar);
+			batch_txn_begin(shm, curr_txn);
 			curr_txn++;
 		}
 
 		shm->current_time = GETHRTIME();
 		if (ENABLED_STATS(options) &&
 		    (time_to_print <= shm->current_time)) {
-			print_progress(shm, prev_ns);
+			print_progress(shm, prev_ns, curr_txn - 1);
 			time_to_print = shm->current_time
 			    + options.interval * 1.0e+6;
 		}
 	}
 	while (shm->global_error == 0 && shm->finished == 0) {
 		shm_process_callouts(shm);
-		print_progress(shm, prev_ns);
-		(void) poll(NULL, 0, 100);
+		print_progress(shm, prev_ns, curr_txn - 1);
+		timeout = batch_poll(shm);
+		(void) poll(NULL, 0, timeout >= 0 ? MIN(timeout, 100) : 100);
 	}
+	(void) batch_txn_end(shm, curr_txn - 1);
 	if (ENABLED_STATS(options)) {
 		(void) printf("\n");
 		uperf_line();
@@ -448,11 +477,14 @@ spawn_strands_group(uperf_shm_t *shm, group_t *gp, int id)
 	int rc;
 	strand_t *s;
 
+	if (compute_calibrate(gp) != UPERF_SUCCESS)
+		return (1);
 	for (j = 0; j < gp->nthreads; j++) {
 		s = shm_get_strand(shm, id + j);
 		s->worklist = group_clone(gp);
 		s->shmptr = shm;
 		s->role = MASTER;
+		s->sid = j;
 		(void) group_assign_stat(shm, s->worklist, id + j);
 
 		if (STRAND_IS_PROCESS(gp)) {
@@ -501,7 +533,8 @@ spawn_strands_group(uperf_shm_t *shm, group_t *gp, int id)
 int
 master(workorder_t *w)
 {
-	int rc;
+	int rc = 0;
+	int regressions = 0;
 	int i;
 	int thr_count;
 	int nthr, nproc;
@@ -585,6 +618,8 @@ master(workorder_t *w)
 
 	(void) wait_for_strands(shm, error);
 	newstat_end(0, AGG_STAT(shm), 0, 0);
+	/* Warmups and cooldowns are not part of the measured run time */
+	AGG_STAT(shm)->start_time += workorder_unmeasured(shm->workorder);
 
 	shm->current_time = GETHRTIME();
 
@@ -603,18 +638,25 @@ master(workorder_t *w)
 
 	if (ENABLED_GROUP_STATS(options))
 		print_group_details(shm);
-	if (ENABLED_THREAD_STATS(options))
+	if (ENABLED_THREAD_STATS(options)) {
 		print_strand_details(shm);
+		print_strand_cpus(shm);
+	}
 	if (ENABLED_TXN_STATS(options))
 		print_txn_averages(shm);
 	if (ENABLED_FLOWOP_STATS(options))
 		print_flowop_averages(shm);
+	if (ENABLED_STATS(options))
+		print_batch_stats();
+	if (options.baseline[0] != '\0' && shm->global_error == 0)
+		regressions = baseline_process(shm, options.baseline);
 #ifdef ENABLE_NETSTAT
 	if (ENABLED_PACKET_STATS(options))
 		print_netstat();
 #endif /* ENABLE_NETSTAT */
 	if (ENABLED_ERROR_STATS(options)) {
 		goodbye_stat_t local;
+		char msg[GOODBYE_MESSAGE_LEN];
 
 		(void) memset(&gtotal, 0, sizeof (goodbye_stat_t));
 		if ((rc = say_goodbyes_and_close(&gtotal, goodbye_timeout))
@@ -626,6 +668,9 @@ master(workorder_t *w)
 			local.bytes_xfer = (AGG_STAT(shm))->size;
 			local.count = (AGG_STAT(shm))->count;
 			print_goodbye_stat("master", &local);
+			if (accept_report(shm, local.elapsed_time, msg,
+			    sizeof (msg)) > 0)
+				(void) printf("%-15.15s %s\n", "", msg);
 			print_difference(local, gtotal);
 		}
 	}
@@ -641,6 +686,10 @@ master(workorder_t *w)
 		exit(1);
 	}
 	shm_fini(shm);
+	if (regressions < 0)
+		return (1);
+	if (regressions > 0 && rc == 0)
+		return (UPERF_EXIT_REGRESSION);
 
 	return (rc);
 }
@@ -493,6 +493,55 @@ print_netstat()
 	(void) uperf_line();
 }
 
+#ifdef UPERF_LINUX
+#define	NETSTAT_SNMP	"/proc/net/netstat"
+#define	NETSTAT_LINE	8192
+
+/*
+ * ListenOverflows of the host: connections dropped because an accept
+ * queue was full. TcpExt is a line of names followed by one of values.
+ */
+int
+netstat_listen_overflows(uint64_t *overflows)
+{
+	static char names[NETSTAT_LINE];
+	static char values[NETSTAT_LINE];
+	char *n, *v, *np, *vp;
+	FILE *f;
+	int rc = UPERF_FAILURE;
+
+	if ((f = fopen(NETSTAT_SNMP, "r")) == NULL)
+		return (UPERF_FAILURE);
+	while (fgets(names, NETSTAT_LINE, f) != NULL &&
+	    fgets(values, NETSTAT_LINE, f) != NULL) {
+		if (strncmp(names, "TcpExt:", 7) != 0)
+			continue;
+		n = strtok_r(names, " \n", &np);
+		v = strtok_r(values, " \n", &vp);
+		while (n != NULL && v != NULL) {
+			if (strcmp(n, "ListenOverflows") == 0) {
+				*overflows = strtoull(v, NULL, 10);
+				rc = UPERF_SUCCESS;
+				break;
+			}
+			n = strtok_r(NULL, " \n", &np);
+			v = strtok_r(NULL, " \n", &vp);
+		}
+		break;
+	}
+	(void) fclose(f);
+
+	return (rc);
+}
+#else
+/* ARGSUSED */
+int
+netstat_listen_overflows(uint64_t *overflows)
+{
+	return (UPERF_FAILURE);
+}
+#endif /* UPERF_LINUX */
+
 #ifdef TESTING
 #include "uperf.h"
 int options;
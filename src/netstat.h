@@ -22,6 +22,7 @@ void print_netstat_xanadu(FILE *fd);
 void print_netstat();
 void netstat_snap(int snaptype);
 int netstat_init();
+int netstat_listen_overflows(uint64_t *);
 
 
 #endif /* _UPERF_NETSTAT_H */
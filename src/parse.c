@@ -40,6 +40,10 @@
 
 #include "workorder.h"
 #include "numbers.h"
+#include "dist.h"
+#include "replay.h"
+#include "strand.h"
+#include "affinity.h"
 #include "protocol.h"
 #include "flowops_library.h"
 #include "sendfilev.h"
@@ -65,6 +69,15 @@ static struct tokenid tlist[] =
 		{ TOKEN_NTHREADS, 		"nthreads="},
 		{ TOKEN_NPROCESSES, 		"nprocs="},
 		{ TOKEN_RATE, 			"rate="},
+		{ TOKEN_NCONNS, 		"nconns="},
+		{ TOKEN_PIPELINE, 		"pipeline="},
+		{ TOKEN_WARMUP, 		"warmup="},
+		{ TOKEN_COOLDOWN, 		"cooldown="},
+		{ TOKEN_CPUS, 			"cpus="},
+		{ TOKEN_SLAVE_CPUS, 		"slavecpus="},
+		{ TOKEN_PLACEMENT, 		"placement="},
+		{ TOKEN_BUFFERS, 		"buffers="},
+		{ TOKEN_HUGEPAGES, 		"hugepages="},
 		};
 
 static int
@@ -105,6 +118,7 @@ next_token(char *s1)
 {
 	char symbol[1024];
 	int i = 0;
+	int keep = 0;
 	static char *p = NULL;
 
 	if (s1 != NULL)
@@ -149,8 +163,15 @@ next_token(char *s1)
 				/* replace newline by space */
 				if (*p == '\n' || *p == '\r')
 					*p = ' ';
-
-				symbol[i++] = tolower(*p++);
+				if (is_seperator(*p))
+					keep = 0;
+				symbol[i++] = keep ? *p++ : tolower(*p++);
+				/* OpenSSL cipher names are case sensitive */
+				if (!keep && i >= 7 &&
+				    strncmp(symbol + i - 7, "cipher=", 7) == 0 &&
+				    (i == 7 || symbol[i - 8] == '=' ||
+				    is_seperator(symbol[i - 8])))
+					keep = 1;
 			}
 			if (*p == '"')
 				p++; /* Ignore " */
@@ -356,32 +377,10 @@ string2int(char *value)
 	return (val);
 }
 
-static char *
-strip(char *str)
-{
-	char *s, *e, *t;
-
-	if (!str)
-		return (0);
-
-	s = str;
-	e = s + strlen(str);
-	t = e - 1;
-	while (s < e && *s == ' ')
-		s++;
-	while (t > s && *t == ' ')
-		t--;
-	if ((s != str) || (t != e -1)) {
-		memmove(str, s, t + 1 - s);
-		str[t + 1 - s] = '\0';
-	}
-
-	return (str);
-}
-
 /*
  * Parse the size= parameter. It currently accpets
- * size=8k, size=8192 or size=rand(1,8k)
+ * size=8k, size=8192, size=rand(1,8k) or any of the
+ * distributions in dist.c, like size=lognormal(4k,1.5)
  * Return a +ve number on success; else -1
  */
 static int
@@ -393,17 +392,14 @@ parse_size(flowop_t *f, char *value)
 
 	if (size > 0)
 		return (size);
-	if (strncasecmp(value, "rand(", 5) == 0) {
-		char *cmin, *cmax;
-		cmin = strtok(value, "(");
-		cmin = strtok(NULL, ",");
-		cmax = strtok(NULL, ")");
-		f->options.rand_sz_min = string2int(strip(cmin));
-		f->options.rand_sz_max = string2int(strip(cmax));
+	if (strchr(value, '(') != NULL) {
+		if ((f->dist = dist_parse(value, DIST_BYTES)) == NULL)
+			return (-1);
+		/* The slave only needs the range, to size its buffer */
+		f->options.rand_sz_min = MAX(1, f->dist->min);
+		f->options.rand_sz_max = MIN(f->dist->max, INT32_MAX);
 		f->options.flag |= O_SIZE_RAND;
-		/* Seed the random generator here */
-		srand(GETHRTIME());
-		if (f->options.rand_sz_min > 0 && f->options.rand_sz_max > 0)
+		if (f->options.rand_sz_min <= f->options.rand_sz_max)
 			return (0);
 	}
 	return (-1);
@@ -443,6 +439,27 @@ parse_option(char *option, flowop_t *flowop)
 	} else if (strcasecmp(option, "non_blocking") == 0) {
 		flowop->options.flag |= O_NONBLOCKING;
 		return (UPERF_SUCCESS);
+	} else if (strcasecmp(option, "prefer_busy_poll") == 0) {
+		flowop->options.flag |= O_PREFER_BUSY_POLL;
+		return (UPERF_SUCCESS);
+	} else if (strcasecmp(option, "framed") == 0) {
+		flowop->options.flag |= O_FRAMED;
+		return (UPERF_SUCCESS);
+	} else if (strcasecmp(option, "shard") == 0) {
+		flowop->options.flag |= O_REPLAY_SHARD;
+		return (UPERF_SUCCESS);
+	} else if (strcasecmp(option, "verify") == 0) {
+		flowop->options.flag |= O_VERIFY;
+		return (UPERF_SUCCESS);
+	} else if (strcasecmp(option, "sink") == 0) {
+		flowop->options.flag |= O_SINK;
+		return (UPERF_SUCCESS);
+	} else if (strcasecmp(option, "reuseport") == 0) {
+		flowop->options.flag |= O_REUSEPORT;
+		return (UPERF_SUCCESS);
+	} else if (strcasecmp(option, "defer_accept") == 0) {
+		flowop->options.flag |= O_DEFER_ACCEPT;
+		return (UPERF_SUCCESS);
 	}
 #ifdef HAVE_SCTP
 	else if (strcasecmp(option, "sctp_unordered") == 0) {
@@ -452,6 +469,18 @@ parse_option(char *option, flowop_t *flowop)
 		flowop->options.flag |= O_SCTP_NODELAY;
 		return (UPERF_SUCCESS);
 	}
+#endif
+#ifdef HAVE_SSL
+	else if (strcasecmp(option, "no_tickets") == 0) {
+		flowop->options.flag |= O_SSL_NO_TICKETS;
+		return (UPERF_SUCCESS);
+	} else if (strcasecmp(option, "resume") == 0) {
+		flowop->options.flag |= O_SSL_RESUME;
+		return (UPERF_SUCCESS);
+	} else if (strcasecmp(option, "early_data") == 0) {
+		flowop->options.flag |= O_SSL_RESUME | O_SSL_EARLY_DATA;
+		return (UPERF_SUCCESS);
+	}
 #endif
 	else {
 		key = strtok(option, "=");
@@ -485,6 +514,99 @@ parse_option(char *option, flowop_t *flowop)
 				add_error(err);
 				return (UPERF_FAILURE);
 			}
+		} else if (strcasecmp(key, "trace") == 0) {
+			if ((flowop->trace = trace_open(value)) == NULL) {
+				snprintf(err, sizeof (err),
+				    "Cannot load trace %s", value);
+				add_error(err);
+				return (UPERF_FAILURE);
+			}
+			/* Replayed messages are framed; size the buffers */
+			flowop->options.size = flowop->trace->max_size;
+			flowop->options.flag |= O_FRAMED;
+		} else if (strcasecmp(key, "scale") == 0) {
+			double scale = strtod(value, &tmp);
+
+			if (*tmp != '\0' || scale < 0 || scale > 1000000) {
+				snprintf(err, sizeof (err),
+				    "Cannot understand scale:%s", value);
+				add_error(err);
+				return (UPERF_FAILURE);
+			}
+			flowop->options.scale = scale * 1000;
+		} else if (strcasecmp(key, "kernel") == 0) {
+			if (strcasecmp(value, "hash") == 0) {
+				flowop->options.kernel = COMPUTE_HASH;
+			} else if (strcasecmp(value, "chase") == 0) {
+				flowop->options.kernel = COMPUTE_CHASE;
+			} else if (strcasecmp(value, "simd") == 0) {
+				flowop->options.kernel = COMPUTE_SIMD;
+			} else {
+				snprintf(err, sizeof (err),
+				    "kernel must be hash, chase or simd: %s",
+				    value);
+				add_error(err);
+				return (UPERF_FAILURE);
+			}
+		} else if (strcasecmp(key, "wss") == 0) {
+			int wss = string2int(value);
+
+			if (wss <= 0) {
+				snprintf(err, sizeof (err),
+				    "Cannot understand wss:%s", value);
+				add_error(err);
+				return (UPERF_FAILURE);
+			}
+			flowop->options.wss = wss;
+		} else if (strcasecmp(key, "touch") == 0) {
+			if (strcasecmp(value, "scan") == 0) {
+				flowop->options.touch = TOUCH_SCAN;
+			} else if (strcasecmp(value, "copy") == 0) {
+				flowop->options.touch = TOUCH_COPY;
+			} else if (strcasecmp(value, "checksum") == 0) {
+				flowop->options.touch = TOUCH_CHECKSUM;
+			} else {
+				snprintf(err, sizeof (err),
+				    "touch must be scan, copy or checksum: %s",
+				    value);
+				add_error(err);
+				return (UPERF_FAILURE);
+			}
+		} else if (strcasecmp(key, "iov") == 0) {
+			int iov = string2int(value);
+
+			if (iov < 1 || iov > FLOWOP_IOV_MAX) {
+				snprintf(err, sizeof (err),
+				    "iov must be between 1 and %d: %s",
+				    FLOWOP_IOV_MAX, value);
+				add_error(err);
+				return (UPERF_FAILURE);
+			}
+			flowop->options.iov = iov;
+		} else if (strcasecmp(key, "coalesce") == 0) {
+			if (strcasecmp(value, "sendmsg") == 0) {
+				flowop->options.coalesce = COALESCE_SENDMSG;
+			} else if (strcasecmp(value, "more") == 0) {
+				flowop->options.coalesce = COALESCE_MORE;
+			} else if (strcasecmp(value, "cork") == 0) {
+				flowop->options.coalesce = COALESCE_CORK;
+			} else {
+				snprintf(err, sizeof (err),
+				    "coalesce must be sendmsg, more or cork: %s",
+				    value);
+				add_error(err);
+				return (UPERF_FAILURE);
+			}
+		} else if (strcasecmp(key, "backlog") == 0) {
+			int backlog = string2int(value);
+
+			if (backlog <= 0) {
+				snprintf(err, sizeof (err),
+				    "Cannot understand backlog:%s", value);
+				add_error(err);
+				return (UPERF_FAILURE);
+			}
+			flowop->options.backlog = backlog;
 		} else if (strcasecmp(key, "rsize") == 0) {
 			flowop->options.rsize = string2int(value);
 		} else if (strcasecmp(key, "nfiles") == 0) {
@@ -552,8 +674,35 @@ parse_option(char *option, flowop_t *flowop)
 				add_error(err);
 				return (UPERF_FAILURE);
 			}
+		} else if (strcasecmp(key, "spin") == 0) {
+			flowop->options.spin = string2nsec(value);
+			if (flowop->options.spin == 0) {
+				snprintf(err, sizeof (err),
+					"Cannot understand spin:%s",
+					value);
+				add_error(err);
+				return (UPERF_FAILURE);
+			}
+		} else if (strcasecmp(key, "busy_poll") == 0) {
+			int res;
+
+			res = string2int(value);
+			if (res > 0) {
+				flowop->options.busy_poll = res;
+			} else {
+				snprintf(err, sizeof(err),
+				         "Cannot understand busy_poll:%s", value);
+				add_error(err);
+				return (UPERF_FAILURE);
+			}
 		} else if (strcasecmp(key, "duration") == 0) {
-			flowop->options.duration = string2nsec(value);
+			if (strchr(value, '(') != NULL) {
+				flowop->dist = dist_parse(value, DIST_NSEC);
+				flowop->options.duration = flowop->dist ?
+				    MAX(1, dist_nominal(flowop->dist)) : 0;
+			} else {
+				flowop->options.duration = string2nsec(value);
+			}
 			if (flowop->options.duration == 0) {
 				snprintf(err, sizeof (err),
 					"Cannot understand duration:%s",
@@ -756,9 +905,20 @@ parse_option(char *option, flowop_t *flowop)
 			strlcpy(flowop->options.engine, value,
 				sizeof (flowop->options.engine));
 		} else if (strcasecmp(key, "cipher") == 0) {
-			strcpy(flowop->options.cipher, value);
+			strlcpy(flowop->options.cipher, value,
+				sizeof (flowop->options.cipher));
 		} else if (strcasecmp(key, "method") == 0) {
-			strcpy(flowop->options.method, value);
+			if (strcasecmp(value, "ssl") != 0 &&
+			    strcasecmp(value, "tls") != 0 &&
+			    strcasecmp(value, "tls1.2") != 0 &&
+			    strcasecmp(value, "tls1.3") != 0) {
+				snprintf(err, sizeof (err),
+					"Unsupported ssl method:%s", value);
+				add_error(err);
+				return (UPERF_FAILURE);
+			}
+			strlcpy(flowop->options.method, value,
+				sizeof (flowop->options.method));
 		}
 #endif
 		else {
@@ -785,6 +945,7 @@ flowop_parse_options(char *str_options, flowop_t *flowop)
 	flowop->options.batch_size = 1; /* Default batch size */
 	flowop->options.size = 0;	/* Default size */
 	flowop->options.duration = 0;	/* Default duration */
+	flowop->options.scale = 1000;	/* Replay in real time */
 	flowop->p_id = UPERF_ANY_CONNECTION;
 
 	for (options = strtok(str_options, delimiters);
@@ -800,6 +961,287 @@ flowop_parse_options(char *str_options, flowop_t *flowop)
 	return (UPERF_SUCCESS);
 }
 
+/*
+ * A pipelined txn is a request (write/send flowops) followed by its
+ * response (read/recv flowops); nothing else can be in flight.
+ */
+static int
+check_pipeline_txn(txn_t *t)
+{
+	char err[1024];
+	flowop_t *f;
+	int req = 0;
+	int resp = 0;
+
+	if (t == NULL || t->pipeline <= 1)
+		return (0);
+	for (f = t->flist; f; f = f->next) {
+		if ((f->type == FLOWOP_WRITE || f->type == FLOWOP_SEND) &&
+		    resp == 0) {
+			req++;
+		} else if (f->type == FLOWOP_READ || f->type == FLOWOP_RECV) {
+			resp++;
+		} else {
+			req = 0;
+			break;
+		}
+	}
+	if (req == 0 || resp == 0 || t->rate_count > 0) {
+		snprintf(err, sizeof (err), "%s: pipeline needs a "
+		    "txn of writes followed by reads, without rate", t->name);
+		add_error(err);
+		return (-1);
+	}
+
+	return (0);
+}
+
+/* A replay flowop needs a trace */
+static int
+check_replay_txn(txn_t *t)
+{
+	char err[1024];
+	flowop_t *f;
+
+	for (f = t ? t->flist : NULL; f; f = f->next) {
+		if (f->type == FLOWOP_REPLAY && f->trace == NULL) {
+			snprintf(err, sizeof (err),
+			    "%s: replay needs a trace=file option", f->name);
+			add_error(err);
+			return (-1);
+		}
+	}
+
+	return (0);
+}
+
+/*
+ * A compute flowop needs an amount of work. By default the hash and
+ * simd kernels work in the L2 cache and chase in memory.
+ */
+static int
+check_compute_txn(txn_t *t)
+{
+	char err[1024];
+	flowop_t *f;
+
+	for (f = t ? t->flist : NULL; f; f = f->next) {
+		if (f->type != FLOWOP_COMPUTE)
+			continue;
+		if (f->options.size == 0 && !FO_RANDOM_SIZE(&f->options) &&
+		    f->options.duration == 0) {
+			snprintf(err, sizeof (err),
+			    "%s: compute needs a size= or duration=", f->name);
+			add_error(err);
+			return (-1);
+		}
+		if (f->options.wss == 0)
+			f->options.wss = f->options.kernel == COMPUTE_CHASE ?
+			    COMPUTE_WSS_MEM : COMPUTE_WSS_CACHE;
+	}
+
+	return (0);
+}
+
+/*
+ * iov= and coalesce= move plain, fixed size messages: none of the
+ * options that look at or frame every message on its own.
+ */
+static int
+check_iov_txn(txn_t *t)
+{
+	char err[1024];
+	flowop_options_t *o;
+	flowop_t *f;
+	int rw;
+
+	for (f = t ? t->flist : NULL; f; f = f->next) {
+		o = &f->options;
+		if (o->iov <= 1 && o->coalesce == COALESCE_NONE)
+			continue;
+		rw = (f->type == FLOWOP_READ || f->type == FLOWOP_WRITE ||
+		    f->type == FLOWOP_RECV || f->type == FLOWOP_SEND);
+		if (!rw || (o->coalesce != COALESCE_NONE &&
+		    f->type != FLOWOP_WRITE && f->type != FLOWOP_SEND)) {
+			snprintf(err, sizeof (err), "%s: iov is for reads and "
+			    "writes, coalesce for writes", f->name);
+			add_error(err);
+			return (-1);
+		}
+		if (o->iov > 1 && o->coalesce != COALESCE_NONE) {
+			snprintf(err, sizeof (err),
+			    "%s: iov and coalesce cannot be combined", f->name);
+			add_error(err);
+			return (-1);
+		}
+		if (FO_FRAMED(o) || FO_RANDOM_SIZE(o) || FO_VERIFY(o) ||
+		    o->touch != TOUCH_NONE) {
+			snprintf(err, sizeof (err), "%s: iov and coalesce cannot "
+			    "be used with framed, rand_sz, verify or touch",
+			    f->name);
+			add_error(err);
+			return (-1);
+		}
+	}
+
+	return (0);
+}
+
+/*
+ * A sink drops what it reads; a write with sink has the peer's read
+ * do so. Nothing can look at the data or its framing then.
+ */
+static int
+check_sink_txn(txn_t *t)
+{
+	char err[1024];
+	flowop_options_t *o;
+	flowop_t *f;
+
+	for (f = t ? t->flist : NULL; f; f = f->next) {
+		o = &f->options;
+		if (!FO_SINK(o))
+			continue;
+		if (f->type != FLOWOP_READ && f->type != FLOWOP_WRITE &&
+		    f->type != FLOWOP_RECV && f->type != FLOWOP_SEND) {
+			snprintf(err, sizeof (err),
+			    "%s: sink is for reads and writes", f->name);
+			add_error(err);
+			return (-1);
+		}
+		if (FO_FRAMED(o) || FO_VERIFY(o) || o->touch != TOUCH_NONE ||
+		    o->iov > 1) {
+			snprintf(err, sizeof (err), "%s: sink cannot be used "
+			    "with framed, verify, touch or iov", f->name);
+			add_error(err);
+			return (-1);
+		}
+	}
+
+	return (0);
+}
+
+/*
+ * reuseport, defer_accept and backlog= shape the listener of an accept
+ * (or of the accept opposite a connect). The first two are TCP only.
+ */
+static int
+check_listen_txn(txn_t *t)
+{
+	char err[1024];
+	flowop_options_t *o;
+	flowop_t *f;
+
+	for (f = t ? t->flist : NULL; f; f = f->next) {
+		o = &f->options;
+		if (!FO_REUSEPORT(o) && !FO_DEFER_ACCEPT(o) && o->backlog == 0)
+			continue;
+		if (f->type != FLOWOP_ACCEPT && f->type != FLOWOP_CONNECT) {
+			snprintf(err, sizeof (err), "%s: reuseport, "
+			    "defer_accept and backlog are for connect and "
+			    "accept", f->name);
+			add_error(err);
+			return (-1);
+		}
+		if ((FO_REUSEPORT(o) || FO_DEFER_ACCEPT(o)) &&
+		    o->protocol != PROTOCOL_TCP) {
+			snprintf(err, sizeof (err), "%s: reuseport and "
+			    "defer_accept need protocol=tcp", f->name);
+			add_error(err);
+			return (-1);
+		}
+		if (o->protocol != PROTOCOL_TCP &&
+		    o->protocol != PROTOCOL_SSL &&
+		    o->protocol != PROTOCOL_SCTP) {
+			snprintf(err, sizeof (err), "%s: backlog needs "
+			    "protocol=tcp, ssl or sctp", f->name);
+			add_error(err);
+			return (-1);
+		}
+	}
+
+	return (0);
+}
+
+/*
+ * nconns multiplexes connections with epoll and keeps its own cursor
+ * per connection, so it only works for stream sockets and ignores
+ * rate limits.
+ */
+static int
+check_async_group(group_t *g)
+{
+	char err[1024];
+	txn_t *t;
+	flowop_t *f;
+
+	if (g == NULL || g->max_async == 0)
+		return (0);
+	for (t = g->tlist; t; t = t->next) {
+		if (t->rate_count > 0 || t->pipeline > 1) {
+			snprintf(err, sizeof (err),
+			    "%s: rate and pipeline cannot be used with nconns",
+			    g->name);
+			add_error(err);
+			return (-1);
+		}
+		for (f = t->flist; f; f = f->next) {
+			if (FO_FRAMED(&f->options) || f->options.iov > 1 ||
+			    f->options.coalesce != COALESCE_NONE) {
+				snprintf(err, sizeof (err), "%s: framed, iov and "
+				    "coalesce cannot be used with nconns",
+				    g->name);
+				add_error(err);
+				return (-1);
+			}
+			if (f->type != FLOWOP_CONNECT &&
+			    f->type != FLOWOP_ACCEPT)
+				continue;
+			if (f->options.protocol != PROTOCOL_TCP &&
+			    f->options.protocol != PROTOCOL_VSOCK) {
+				snprintf(err, sizeof (err),
+				    "%s: nconns needs tcp or vsock connections",
+				    g->name);
+				add_error(err);
+				return (-1);
+			}
+		}
+	}
+
+	return (0);
+}
+
+/* warmup= and cooldown= take a duration, or 0 */
+static uint64_t
+string2window(char *value)
+{
+	if (strspn(value, "0") == strlen(value))
+		return (0);
+	return (string2nsec(value));
+}
+
+/* Warmup and cooldown must leave part of every duration txn measured */
+static int
+check_window_group(group_t *g)
+{
+	char err[1024];
+	txn_t *t;
+
+	if (g->warmup == 0 && g->cooldown == 0)
+		return (0);
+	for (t = g->tlist; t; t = t->next) {
+		if (t->duration > 0 && g->warmup + g->cooldown >= t->duration) {
+			snprintf(err, sizeof (err),
+			    "%s: warmup and cooldown leave nothing of %s to "
+			    "measure", g->name, t->name);
+			add_error(err);
+			return (-1);
+		}
+	}
+
+	return (0);
+}
+
 static workorder_t *
 build_worklist(struct symbol *list)
 {
@@ -812,6 +1254,8 @@ build_worklist(struct symbol *list)
 	int fid = 0;
 	int in_group = 0;
 	int in_txn = 0;
+	uint64_t warmup = 0;	/* Profile defaults for the groups */
+	uint64_t cooldown = 0;
 
 	w.ngrp = 0;
 	bzero(&w, sizeof (workorder_t));
@@ -826,6 +1270,9 @@ build_worklist(struct symbol *list)
 			curr_grp = &w.grp[w.ngrp++];
 			bzero(curr_grp, sizeof (group_t));
 			curr_grp->endian = UPERF_ENDIAN_VALUE;
+			curr_grp->warmup = warmup;
+			curr_grp->cooldown = cooldown;
+			curr_grp->nbuffers = 1;
 			curr_txn = 0;
 			curr_flowop = 0;
 			txnid = 0;
@@ -834,6 +1281,9 @@ build_worklist(struct symbol *list)
 			    w.ngrp - 1);
 			break;
 		case TOKEN_GROUP_END:
+			if (check_async_group(curr_grp) != 0 ||
+			    check_window_group(curr_grp) != 0)
+				return (NULL);
 			in_group = 0;
 			break;
 		case TOKEN_TXN_START:
@@ -860,6 +1310,13 @@ build_worklist(struct symbol *list)
 			in_txn = 1;
 			break;
 		case TOKEN_TXN_END:
+			if (check_pipeline_txn(curr_txn) != 0 ||
+			    check_replay_txn(curr_txn) != 0 ||
+			    check_compute_txn(curr_txn) != 0 ||
+			    check_iov_txn(curr_txn) != 0 ||
+			    check_sink_txn(curr_txn) != 0 ||
+			    check_listen_txn(curr_txn) != 0)
+				return (NULL);
 			in_txn = 0;
 			break;
 		case TOKEN_FLOWOP_START:
@@ -927,6 +1384,21 @@ build_worklist(struct symbol *list)
 			strlcpy(curr_txn->rate_str, list->symbol, NAMELEN);
 			curr_txn->rate_count = string2int(list->symbol);
 			break;
+		case TOKEN_PIPELINE:
+			if (!in_txn) {
+				snprintf(err, sizeof (err),
+				    "No current transaction");
+				add_error(err);
+				return (NULL);
+			}
+			if (string2int(list->symbol) <= 0) {
+				snprintf(err, sizeof (err),
+				    "Invalid pipeline %s", list->symbol);
+				add_error(err);
+				return (NULL);
+			}
+			curr_txn->pipeline = string2int(list->symbol);
+			break;
 		case TOKEN_DURATION:
 			if (!in_txn) {
 				snprintf(err, sizeof (err),
@@ -964,6 +1436,125 @@ build_worklist(struct symbol *list)
 			curr_grp->strand_flag |= STRAND_TYPE_PROCESS;
 			break;
 #endif /* STRAND_THREAD_ONLY */
+		case TOKEN_NCONNS:
+#ifndef HAVE_SYS_EPOLL_H
+			snprintf(err, sizeof (err),
+				"nconns is not supported on this platform");
+			add_error(err);
+			return (NULL);
+#else
+			if (!in_group) {
+				snprintf(err, sizeof (err),
+				    "No current group");
+				add_error(err);
+				return (NULL);
+			}
+			if (string2int(list->symbol) <= 0) {
+				snprintf(err, sizeof (err),
+				    "Invalid nconns %s", list->symbol);
+				add_error(err);
+				return (NULL);
+			}
+			curr_grp->max_async = string2int(list->symbol);
+			break;
+#endif /* HAVE_SYS_EPOLL_H */
+		case TOKEN_WARMUP:
+			if (in_txn) {
+				snprintf(err, sizeof (err),
+				    "warmup belongs to a group or the profile");
+				add_error(err);
+				return (NULL);
+			}
+			if (in_group)
+				curr_grp->warmup = string2window(list->symbol);
+			else
+				warmup = string2window(list->symbol);
+			break;
+		case TOKEN_COOLDOWN:
+			if (in_txn) {
+				snprintf(err, sizeof (err),
+				    "cooldown belongs to a group or the profile");
+				add_error(err);
+				return (NULL);
+			}
+			if (in_group)
+				curr_grp->cooldown = string2window(list->symbol);
+			else
+				cooldown = string2window(list->symbol);
+			break;
+		case TOKEN_CPUS:
+		case TOKEN_SLAVE_CPUS:
+			if (!in_group || in_txn) {
+				snprintf(err, sizeof (err),
+				    "CPU lists belong to a group");
+				add_error(err);
+				return (NULL);
+			}
+			if (cpulist_check(list->symbol) != 0) {
+				snprintf(err, sizeof (err),
+				    "Invalid CPU list %s", list->symbol);
+				add_error(err);
+				return (NULL);
+			}
+			(void) strlcpy(list->type == TOKEN_CPUS ?
+			    curr_grp->cpus : curr_grp->slave_cpus,
+			    list->symbol, GROUP_CPULIST_LEN);
+			break;
+		case TOKEN_PLACEMENT:
+			if (!in_group || in_txn) {
+				snprintf(err, sizeof (err),
+				    "placement belongs to a group");
+				add_error(err);
+				return (NULL);
+			}
+			if (strcasecmp(list->symbol, "rr") == 0) {
+				curr_grp->placement = GROUP_PLACE_RR;
+			} else if (strcasecmp(list->symbol, "compact") == 0) {
+				curr_grp->placement = GROUP_PLACE_COMPACT;
+			} else {
+				snprintf(err, sizeof (err),
+				    "placement must be rr or compact, not %s",
+				    list->symbol);
+				add_error(err);
+				return (NULL);
+			}
+			break;
+		case TOKEN_BUFFERS:
+			if (!in_group || in_txn) {
+				snprintf(err, sizeof (err),
+				    "buffers belongs to a group");
+				add_error(err);
+				return (NULL);
+			}
+			curr_grp->nbuffers = string2int(list->symbol);
+			if (curr_grp->nbuffers == 0 ||
+			    curr_grp->nbuffers > BUFPOOL_MAX) {
+				snprintf(err, sizeof (err),
+				    "buffers must be 1 to %d, not %s",
+				    BUFPOOL_MAX, list->symbol);
+				add_error(err);
+				return (NULL);
+			}
+			break;
+		case TOKEN_HUGEPAGES:
+			if (!in_group || in_txn) {
+				snprintf(err, sizeof (err),
+				    "hugepages belongs to a group");
+				add_error(err);
+				return (NULL);
+			}
+			if (strcasecmp(list->symbol, "on") == 0) {
+				curr_grp->hugepages = 1;
+			} else if (strcasecmp(list->symbol, "off") == 0) {
+				curr_grp->hugepages = 0;
+			} else {
+				snprintf(err, sizeof (err),
+				    "hugepages must be on or off, not %s",
+				    list->symbol);
+				add_error(err);
+				return (NULL);
+			}
+			break;
 		case TOKEN_ERROR:
 			snprintf(err, sizeof (err),
 				"Unknown symbol: %s", list->symbol);
@@ -34,6 +34,15 @@
 #define	TOKEN_NTHREADS		14
 #define	TOKEN_NPROCESSES	15
 #define	TOKEN_RATE		16
+#define	TOKEN_NCONNS		17
+#define	TOKEN_PIPELINE		18
+#define	TOKEN_WARMUP		19
+#define	TOKEN_COOLDOWN		20
+#define	TOKEN_CPUS		21
+#define	TOKEN_SLAVE_CPUS	22
+#define	TOKEN_PLACEMENT		23
+#define	TOKEN_BUFFERS		24
+#define	TOKEN_HUGEPAGES		25
 #define	TOKEN_ERROR		99
 
 struct symbol {
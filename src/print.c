@@ -51,6 +51,13 @@ extern options_t options;
 #define	WINDOW_WIDTH	128
 
 #define	AVG_HDR	"   Count         avg         cpu         max         min "
+#define	PCT_HDR	"   Count         p50         p90         p99       p99.9 "
+#define	SPIN_HDR	"   Count        spin      useful       spin% "
+#define	CALL_HDR	"   Count  syscalls/op  bytes/call "
+#define	TOUCH_HDR	"   Count       touch     syscall      touch% "
+#define	SKEW_HDR	" Strands  start skew "
+#define	THINK_HDR	"   Count   requested      actual   overshoot "
+#define	COMPUTE_HDR	"   Count        idle      actual    slowdown "
 
 /* We calculate the width only on the first call to save repeated ioctls */
 static int
@@ -154,11 +161,43 @@ print_average(newstats_t *ns)
 	}
 }
 
+static void
+print_percentiles(newstats_t *ns)
+{
+	if (!ns || ns->count == 0)
+		return;
+
+	printf("%-15s %8"PRIu64" ", ns->name, ns->count);
+	PRINT_TIME(stats_percentile(ns, 50.0), 11);
+	PRINT_TIME(stats_percentile(ns, 90.0), 11);
+	PRINT_TIME(stats_percentile(ns, 99.0), 11);
+	PRINT_TIME(stats_percentile(ns, 99.9), 11);
+	printf("\n");
+}
+
+static void
+txn_stats(uperf_shm_t *shm, group_t *g, txn_t *txn, newstats_t *ns)
+{
+	int j;
+
+	bzero(ns, sizeof (*ns));
+	ns->min = ULONG_MAX;
+	ns->start_time = ULONG_MAX;
+	for (j = 0; j < shm->nstat_count; j++) {
+		newstats_t *p = &shm->nstats[j];
+		if ((p->type == NSTAT_TXN) &&
+		    (p->gid == GROUP_ID(g)) &&
+		    (p->tid == TXN_ID(txn)))
+			add_stats(ns, p);
+	}
+	snprintf(ns->name, sizeof (ns->name), "Txn%d", TXN_ID(txn));
+}
+
 /* Txn1 42.63GB/29.40(s) = 12.45Gb/s 19681txn/s */
 void
 print_txn_averages(uperf_shm_t *shm)
 {
-	int i, j;
+	int i;
 	workorder_t *w = shm->workorder;
 	group_t *g;
 	txn_t *txn;
@@ -168,22 +207,37 @@ print_txn_averages(uperf_shm_t *shm)
 	for (i = 0; i < w->ngrp; i++) {
 		g = &w->grp[i];
 		for (txn = g->tlist; txn; txn = txn->next) {
-			bzero(&ns, sizeof (ns));
-			ns.min = ULONG_MAX;
-			ns.start_time = ULONG_MAX;
-			for (j = 0; j < shm->nstat_count; j++) {
-				newstats_t *p = &shm->nstats[j];
-				if ((p->type == NSTAT_TXN) &&
-				    (p->gid == GROUP_ID(g)) &&
-				    (p->tid == TXN_ID(txn)))
-					add_stats(&ns, p);
-			}
-			snprintf(ns.name, sizeof (ns.name), "Txn%d",
-			    TXN_ID(txn));
+			txn_stats(shm, g, txn, &ns);
 			print_average(&ns);
 		}
 	}
 	printf("\n");
+
+	printf("\n%-15s %s\n", "Txn", PCT_HDR);
+	uperf_line();
+	for (i = 0; i < w->ngrp; i++) {
+		g = &w->grp[i];
+		for (txn = g->tlist; txn; txn = txn->next) {
+			txn_stats(shm, g, txn, &ns);
+			print_percentiles(&ns);
+		}
+	}
+	printf("\n");
+
+	/* Time between the first and the last strand starting a txn */
+	if (shm->nobarrier == 0 || barrier_skew(&shm->bar[0]) == 0)
+		return;
+	printf("\n%-15s %s\n", "Txn", SKEW_HDR);
+	uperf_line();
+	for (i = 0; i < shm->nobarrier; i++) {
+		char name[32];
+
+		(void) snprintf(name, sizeof (name), "Txn%d", i + 1);
+		printf("%-15s %8u ", name, shm->bar[i].limit);
+		PRINT_TIME(barrier_skew(&shm->bar[i]), 11);
+		printf("\n");
+	}
+	printf("\n");
 }
 
 /* Group0 42.63GB/29.40(s) = 12.45Gb/s 19681txn/s 50.81us/txn */
@@ -235,38 +289,211 @@ print_strand_details(uperf_shm_t *shm)
 	printf("\n");
 }
 
+static void
+print_spin(newstats_t *ns)
+{
+	if (!ns || ns->count == 0 || ns->spin_time == 0)
+		return;
+
+	printf("%-15s %8"PRIu64" ", ns->name, ns->count);
+	PRINT_TIME(ns->spin_time/ns->count, 11);
+	PRINT_TIME((ns->time_used - MIN(ns->spin_time, ns->time_used))
+	    /ns->count, 11);
+	printf("%11.2f%%\n", 100.0 * ns->spin_time / ns->time_used);
+}
+
+static void
+print_touch(newstats_t *ns)
+{
+	if (!ns || ns->count == 0 || ns->touch_time == 0)
+		return;
+
+	printf("%-15s %8"PRIu64" ", ns->name, ns->count);
+	PRINT_TIME(ns->touch_time/ns->count, 11);
+	PRINT_TIME((ns->time_used - MIN(ns->touch_time, ns->time_used))
+	    /ns->count, 11);
+	printf("%11.2f%%\n", 100.0 * ns->touch_time / ns->time_used);
+}
+
+static void
+print_think(newstats_t *ns)
+{
+	if (!ns || ns->count == 0 || ns->think_req == 0)
+		return;
+
+	printf("%-15s %8"PRIu64" ", ns->name, ns->count);
+	PRINT_TIME(ns->think_req/ns->count, 11);
+	PRINT_TIME(ns->think_time/ns->count, 11);
+	PRINT_TIME(ns->think_time > ns->think_req ?
+	    (double)(ns->think_time - ns->think_req)/ns->count : 0, 11);
+	printf("\n");
+}
+
+static void
+print_syscalls(newstats_t *ns)
+{
+	if (!ns || ns->count == 0 || ns->syscalls == 0)
+		return;
+
+	printf("%-15s %8"PRIu64" ", ns->name, ns->count);
+	printf("%12.2f %11.0f\n", (double)ns->syscalls / ns->count,
+	    (double)ns->size / ns->syscalls);
+}
+
+/* Compute time per op when idle (calibrated), actually, and the ratio */
+static void
+print_compute(newstats_t *ns)
+{
+	if (!ns || ns->count == 0 || ns->compute_time == 0)
+		return;
+
+	printf("%-15s %8"PRIu64" ", ns->name, ns->count);
+	PRINT_TIME(ns->compute_req/ns->count, 11);
+	PRINT_TIME(ns->compute_time/ns->count, 11);
+	if (ns->compute_req > 0)
+		printf("%11.2fx\n", (double)ns->compute_time /
+		    ns->compute_req);
+	else
+		printf("%12s\n", "-");
+}
+
+/* Stats of flowop f summed over all the strands */
+void
+flowop_stats(uperf_shm_t *shm, int gid, txn_t *txn, flowop_t *f,
+    newstats_t *ns)
+{
+	int j;
+
+	bzero(ns, sizeof (*ns));
+	ns->min = ULONG_MAX;
+	ns->start_time = ULONG_MAX;
+	strlcpy(ns->name, f->name, sizeof (ns->name));
+	for (j = 0; j < shm->nstat_count; j++) {
+		newstats_t *p = &shm->nstats[j];
+		if ((p->type == NSTAT_FLOWOP) &&
+		    (p->gid == gid) &&
+		    (p->tid == TXN_ID(txn)) &&
+		    (p->fid == FLOWOP_ID(f)))
+			add_stats(ns, p);
+	}
+}
+
 void
 print_flowop_averages(uperf_shm_t *shm)
 {
-	int i, j;
+	int i;
 	workorder_t *w = shm->workorder;
 	group_t *g;
 	txn_t *txn;
 	flowop_t *f;
 	newstats_t ns;
+	uint64_t spin = 0;
+	uint64_t calls = 0;
+	uint64_t think = 0;
+	uint64_t touch = 0;
+	uint64_t compute = 0;
 
 	print_avg_header("Flowop");
 	for (i = 0; i < w->ngrp; i++) {
 		g = &w->grp[i];
 		for (txn = g->tlist; txn; txn = txn->next) {
 			for (f = txn->flist; f; f = f->next) {
-				bzero(&ns, sizeof (ns));
-				ns.min = ULONG_MAX;
-				ns.start_time = ULONG_MAX;
-				strlcpy(ns.name, f->name, sizeof (ns.name));
-				for (j = 0; j < shm->nstat_count; j++) {
-					newstats_t *p = &shm->nstats[j];
-					if ((p->type == NSTAT_FLOWOP) &&
-					    (p->gid == i) &&
-					    (p->tid == TXN_ID(txn)) &&
-					    (p->fid == FLOWOP_ID(f)))
-						add_stats(&ns, p);
-				}
+				flowop_stats(shm, i, txn, f, &ns);
 				print_average(&ns);
 			}
 		}
 	}
 	printf("\n");
+
+	printf("\n%-15s %s\n", "Flowop", PCT_HDR);
+	uperf_line();
+	for (i = 0; i < w->ngrp; i++) {
+		g = &w->grp[i];
+		for (txn = g->tlist; txn; txn = txn->next) {
+			for (f = txn->flist; f; f = f->next) {
+				flowop_stats(shm, i, txn, f, &ns);
+				print_percentiles(&ns);
+				spin += ns.spin_time;
+				calls += ns.syscalls;
+				think += ns.think_req;
+				touch += ns.touch_time;
+				compute += ns.compute_time;
+			}
+		}
+	}
+	printf("\n");
+
+	if (calls > 0) {
+		printf("\n%-15s %s\n", "Syscalls", CALL_HDR);
+		uperf_line();
+		for (i = 0; i < w->ngrp; i++) {
+			g = &w->grp[i];
+			for (txn = g->tlist; txn; txn = txn->next) {
+				for (f = txn->flist; f; f = f->next) {
+					flowop_stats(shm, i, txn, f, &ns);
+					print_syscalls(&ns);
+				}
+			}
+		}
+		printf("\n");
+	}
+	if (touch > 0) {
+		printf("\n%-15s %s\n", "Data touch", TOUCH_HDR);
+		uperf_line();
+		for (i = 0; i < w->ngrp; i++) {
+			g = &w->grp[i];
+			for (txn = g->tlist; txn; txn = txn->next) {
+				for (f = txn->flist; f; f = f->next) {
+					flowop_stats(shm, i, txn, f, &ns);
+					print_touch(&ns);
+				}
+			}
+		}
+		printf("\n");
+	}
+	if (think > 0) {
+		printf("\n%-15s %s\n", "Think", THINK_HDR);
+		uperf_line();
+		for (i = 0; i < w->ngrp; i++) {
+			g = &w->grp[i];
+			for (txn = g->tlist; txn; txn = txn->next) {
+				for (f = txn->flist; f; f = f->next) {
+					flowop_stats(shm, i, txn, f, &ns);
+					print_think(&ns);
+				}
+			}
+		}
+		printf("\n");
+	}
+	if (compute > 0) {
+		printf("\n%-15s %s\n", "Compute", COMPUTE_HDR);
+		uperf_line();
+		for (i = 0; i < w->ngrp; i++) {
+			g = &w->grp[i];
+			for (txn = g->tlist; txn; txn = txn->next) {
+				for (f = txn->flist; f; f = f->next) {
+					flowop_stats(shm, i, txn, f, &ns);
+					print_compute(&ns);
+				}
+			}
+		}
+		printf("\n");
+	}
+	if (spin == 0)
+		return;
+
+	printf("\n%-15s %s\n", "Busy-poll", SPIN_HDR);
+	uperf_line();
+	for (i = 0; i < w->ngrp; i++) {
+		g = &w->grp[i];
+		for (txn = g->tlist; txn; txn = txn->next) {
+			for (f = txn->flist; f; f = f->next) {
+				flowop_stats(shm, i, txn, f, &ns);
+				print_spin(&ns);
+			}
+		}
+	}
+	printf("\n");
 }
 
 void
@@ -32,6 +32,7 @@ void print_strand_details(uperf_shm_t *shm);
 void print_txn_averages(uperf_shm_t *shm);
 void print_flowop_averages(uperf_shm_t *shm);
 void print_goodbye_stat_header();
+void flowop_stats(uperf_shm_t *, int, txn_t *, flowop_t *, newstats_t *);
 int uperf_line();
 
 #endif /* _PRINT_H */
@@ -66,8 +66,22 @@ struct _protocol_t {
 	int p_id;			/* connection ID */
 	int fd;				/* connection desc */
 	char host[MAXHOSTNAME];		/* Remote host */
+	uint64_t spin_time;		/* Time spent busy-polling reads */
+	uint64_t syscalls;		/* I/O syscalls issued */
+	uint64_t rcvtimeo;		/* SO_RCVTIMEO in effect (nsecs) */
+	uint64_t sndtimeo;		/* SO_SNDTIMEO in effect (nsecs) */
+	int nonblock;			/* fd is O_NONBLOCK, poll on EAGAIN */
+	hrtime_t deadline;		/* Don't block past this (0: forever) */
+	uint32_t frame_txid;		/* Last framed request sent */
+	uint32_t frame_ackid;		/* Last framed reply received */
+	uint32_t frame_rxid;		/* Last framed request received */
+	uint32_t frame_rlen;		/* Reply size it asked for */
+	uint32_t frame_skip;		/* Replayed reads already answered */
+	uint64_t verify_tx;		/* Stream offsets of verify */
+	uint64_t verify_rx;
 	protocol_t *next;
 	protocol_t *prev;
+	protocol_t *hnext;		/* Next in its strand's bucket */
 	void *_protocol_p;		/* Pointer to private data */
 };
 
@@ -31,9 +31,10 @@
 #define	TIMESHIFT		10
 #define	TIME_EXPIRED(A)	((GETHRTIME() >> TIMESHIFT) > ((A) >> TIMESHIFT))
 
-/* Runs for around 1s/INTERVALS_PER_SEC */
+/* Runs for around 1s/INTERVALS_PER_SEC, or until stop */
 static int
-rate_delta(void *a, void *b, int rate, int (*callback)(void *, void *))
+rate_delta(void *a, void *b, int rate, hrtime_t stop,
+    int (*callback)(void *, void *))
 {
 	hrtime_t end, sleep_time;
 	hrtime_t local_stop;
@@ -46,7 +47,7 @@ rate_delta(void *a, void *b, int rate, int (*callback)(void *, void *))
 		per_loop = 1;
 
 	/* Do atleast per_loop or until duration is passed */
-	local_stop = GETHRTIME() + 1.0e+9/INTERVALS_PER_SEC;
+	local_stop = MIN(GETHRTIME() + 1.0e+9/INTERVALS_PER_SEC, stop);
 
 	for (i = 0; i < per_loop; i++) {
 		if (TIME_EXPIRED(local_stop))
@@ -60,7 +61,7 @@ rate_delta(void *a, void *b, int rate, int (*callback)(void *, void *))
 	/* Sleep remainder of the interval */
 	sleep_time = (hrtime_t) (local_stop - end);
 	/* Tests with nanosleep indicate that nanosleep is atleast 2000ns */
-	if (sleep_time > 2000)
+	if (local_stop > end && sleep_time > 2000)
 		return (uperf_sleep(sleep_time));
 	else
 		return (0);
@@ -68,12 +69,14 @@ rate_delta(void *a, void *b, int rate, int (*callback)(void *, void *))
 
 /*
  * This function returns in
- * roughly 1 sec (or less if duration is expired).
+ * roughly 1 sec (or less if duration is expired). It never sleeps
+ * past stop, the end of the duration.
  *
  * Returns 0 on sucCESS OR Errno
  */
 int
-rate_execute_1s(void *a, void *b, int rate, int (*callback)(void *, void *))
+rate_execute_1s(void *a, void *b, int rate, hrtime_t stop,
+    int (*callback)(void *, void *))
 {
 	hrtime_t begin, end;
 	int i, ret;
@@ -83,21 +86,22 @@ rate_execute_1s(void *a, void *b, int rate, int (*callback)(void *, void *))
 	begin = GETHRTIME();
 	ret = 0;
 	for (i = 0; i < INTERVALS_PER_SEC && ret == 0; i++) {
-		ret = rate_delta(a, b, rate, callback);
+		ret = rate_delta(a, b, rate, stop, callback);
 	}
 	if (ret != 0)
 		return (ret);
 	else {
 		end = GETHRTIME();
-		if ((end - begin) < 1.0e+9)
-			return (uperf_sleep(1.0e+9 - (end - begin)));
+		if ((end - begin) < 1.0e+9 && end < stop)
+			return (uperf_sleep(MIN(1.0e+9 - (end - begin),
+			    stop - end)));
 		return (ret);
 	}
 }
 
 /* This function is busy wait version of rate_execute_1s */
 int
-rate_execute_1s_busywait(void *a, void *b, int rate,
+rate_execute_1s_busywait(void *a, void *b, int rate, hrtime_t stop,
 	int (*callback)(void *, void *))
 {
 	hrtime_t begin, now;
@@ -109,7 +113,7 @@ rate_execute_1s_busywait(void *a, void *b, int rate,
 	begin = GETHRTIME();
 	now = GETHRTIME();
 
-	while ((now - begin) < 1.0e+9) {
+	while ((now - begin) < 1.0e+9 && now < stop) {
 		if ((now - begin) >= (interval * i)) {
 			if ((ret = callback(a, b)) != 0) {
 				return (ret);
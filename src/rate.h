@@ -18,7 +18,9 @@
 #ifndef _RATE_H
 #define	_RATE_H
 
-int rate_execute_1s(void *, void *, int, int (*callback)(void *, void *));
-int rate_execute_1s_busywait(void *, void *, int, int (*callback)(void *, void *));
+int rate_execute_1s(void *, void *, int, hrtime_t,
+    int (*callback)(void *, void *));
+int rate_execute_1s_busywait(void *, void *, int, hrtime_t,
+    int (*callback)(void *, void *));
 
 #endif /* _RATE_H */
@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2008 Sun Microsystems
+ *
+ * This file is part of uperf.
+ *
+ * uperf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3
+ * as published by the Free Software Foundation.
+ *
+ * uperf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with uperf.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/*
+ * Traces for the replay flowop. A trace is a text file with one
+ * message per line:
+ *
+ *	<gap> <w|r> <size>
+ *
+ * gap is the time since the previous message (150us, 2ms, 0), w a
+ * message the master sends and r one it receives. Lines starting
+ * with # are comments. The file is mapped once by the master and
+ * parsed as it is replayed, so traces can be much larger than memory
+ * would allow if they were loaded.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif /* HAVE_STRING_H */
+
+#include "uperf.h"
+#include "logging.h"
+#include "numbers.h"
+#include "replay.h"
+
+#define	TRACE_LINE	128
+
+/* Start of the line after p */
+static char *
+trace_eol(char *p, char *end)
+{
+	char *nl = memchr(p, '\n', end - p);
+
+	return (nl ? nl + 1 : end);
+}
+
+/*
+ * Parse the line at p. Returns 0 for a record, 1 for a blank line or
+ * a comment, -1 if the line is not valid.
+ */
+static int
+trace_parse(char *p, char *end, trace_record_t *r)
+{
+	char line[TRACE_LINE];
+	char *gap, *dir, *size, *last;
+	int len = trace_eol(p, end) - p;
+	int sz;
+
+	if (len >= sizeof (line))
+		return (-1);
+	(void) memcpy(line, p, len);
+	line[len] = '\0';
+	/* Strands parse at the same time: no strtok() */
+	if ((gap = strtok_r(line, " \t\r\n", &last)) == NULL || *gap == '#')
+		return (1);
+	dir = strtok_r(NULL, " \t\r\n", &last);
+	size = strtok_r(NULL, " \t\r\n", &last);
+	if (dir == NULL || size == NULL || dir[1] != '\0')
+		return (-1);
+	if (*dir == 'w' || *dir == 'W')
+		r->dir = TRACE_WRITE;
+	else if (*dir == 'r' || *dir == 'R')
+		r->dir = TRACE_READ;
+	else
+		return (-1);
+	if ((sz = string_to_int(size)) <= 0)
+		return (-1);
+	r->size = sz;
+	if (strspn(gap, "0") == strlen(gap)) {
+		r->gap = 0;
+	} else {
+		r->gap = string_to_nsec(gap);
+		if (r->gap == 0 || r->gap == (uint64_t)-1)
+			return (-1);
+	}
+
+	return (0);
+}
+
+/* Map file and check every record in it */
+trace_t *
+trace_open(char *file)
+{
+	trace_record_t r;
+	struct stat st;
+	trace_t *t;
+	char *p, *end;
+	int line = 1;
+	int fd;
+
+	if ((fd = open(file, O_RDONLY)) < 0) {
+		uperf_error("Cannot open trace %s\n", file);
+		return (NULL);
+	}
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		uperf_error("Trace %s is empty\n", file);
+		(void) close(fd);
+		return (NULL);
+	}
+	if ((t = calloc(1, sizeof (trace_t))) == NULL) {
+		(void) close(fd);
+		return (NULL);
+	}
+	t->len = st.st_size;
+	t->base = mmap(NULL, t->len, PROT_READ, MAP_SHARED, fd, 0);
+	(void) close(fd);
+	if (t->base == MAP_FAILED) {
+		uperf_error("Cannot map trace %s\n", file);
+		free(t);
+		return (NULL);
+	}
+
+	end = t->base + t->len;
+	for (p = t->base; p < end; p = trace_eol(p, end), line++) {
+		switch (trace_parse(p, end, &r)) {
+		case 0:
+			t->nrecords++;
+			t->max_size = MAX(t->max_size, r.size);
+			break;
+		case 1:
+			break;
+		default:
+			uperf_error("%s:%d: expected \"<gap> <w|r> <size>\"\n",
+			    file, line);
+			(void) munmap(t->base, t->len);
+			free(t);
+			return (NULL);
+		}
+	}
+	if (t->nrecords == 0) {
+		uperf_error("Trace %s has no records\n", file);
+		(void) munmap(t->base, t->len);
+		free(t);
+		return (NULL);
+	}
+
+	return (t);
+}
+
+/* Start of the first line at or after p */
+static char *
+trace_align(trace_t *t, char *p)
+{
+	if (p == t->base)
+		return (p);
+	return (trace_eol(p - 1, t->base + t->len));
+}
+
+/*
+ * A cursor over shard of nshards equal slices of t. Returns NULL if
+ * the shard has no records.
+ */
+trace_cursor_t *
+trace_cursor(trace_t *t, int shard, int nshards)
+{
+	trace_cursor_t *c;
+	trace_record_t r;
+	char *p;
+
+	if ((c = calloc(1, sizeof (trace_cursor_t))) == NULL)
+		return (NULL);
+	c->trace = t;
+	c->start = trace_align(t, t->base + t->len * shard / nshards);
+	c->end = trace_align(t, t->base + t->len * (shard + 1) / nshards);
+	for (p = c->start; p < c->end; p = trace_eol(p, c->end)) {
+		if (trace_parse(p, c->end, &r) == 0)
+			break;
+	}
+	if (p >= c->end) {
+		uperf_error("Trace shard %d of %d is empty\n", shard, nshards);
+		free(c);
+		return (NULL);
+	}
+	c->start = c->pos = p;
+
+	return (c);
+}
+
+/* The record at the cursor, wrapping around at the end of the shard */
+static char *
+trace_read(trace_cursor_t *c, trace_record_t *r)
+{
+	char *p = c->pos;
+
+	for (;;) {
+		if (p >= c->end)
+			p = c->start;
+		if (trace_parse(p, c->end, r) == 0)
+			return (trace_eol(p, c->end));
+		p = trace_eol(p, c->end);
+	}
+}
+
+void
+trace_next(trace_cursor_t *c, trace_record_t *r)
+{
+	c->pos = trace_read(c, r);
+}
+
+void
+trace_peek(trace_cursor_t *c, trace_record_t *r)
+{
+	(void) trace_read(c, r);
+}
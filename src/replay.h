@@ -0,0 +1,52 @@
+/* Copyright (C) 2008 Sun Microsystems
+ *
+ * This file is part of uperf.
+ *
+ * uperf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3
+ * as published by the Free Software Foundation.
+ *
+ * uperf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with uperf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _REPLAY_H
+#define	_REPLAY_H
+
+/* A memory mapped trace, shared by all strands */
+typedef struct trace {
+	char		*base;
+	size_t		len;
+	uint64_t	nrecords;
+	uint32_t	max_size;	/* Largest message in the trace */
+} trace_t;
+
+/* A strand's position in its shard of the trace */
+typedef struct trace_cursor {
+	trace_t		*trace;
+	char		*start;		/* Shard boundaries */
+	char		*end;
+	char		*pos;
+	int		requested;	/* Next read was asked for by a write */
+} trace_cursor_t;
+
+#define	TRACE_WRITE	0
+#define	TRACE_READ	1
+
+typedef struct trace_record {
+	uint64_t	gap;		/* nsecs since the previous record */
+	uint32_t	size;
+	int		dir;		/* TRACE_WRITE or TRACE_READ */
+} trace_record_t;
+
+trace_t *trace_open(char *);
+trace_cursor_t *trace_cursor(trace_t *, int, int);
+void trace_next(trace_cursor_t *, trace_record_t *);
+void trace_peek(trace_cursor_t *, trace_record_t *);
+
+#endif /* _REPLAY_H */
@@ -49,7 +49,7 @@
 #include "shm.h"
 
 #define	ONE_SEC			1.0e+9
-#define	CALLOUT_GRANURALITY	ONE_SEC
+#define	CALLOUT_GRACE		(2 * ONE_SEC)
 
 
 #ifdef USE_SHMGET
@@ -66,58 +66,63 @@ shm_get_strand(uperf_shm_t *shm, int id)
 }
 
 /*
- * Register a callout for time "stop". At "stop" time, strands
- * belonging to group_id will be "called" (signalled) out
- * No need for locks as only one strand per group will register
+ * Duration txns end by themselves: every strand stops at its
+ * deadline. A strand still busy CALLOUT_GRACE after it is stuck in
+ * something the deadline cannot cut short, and is signalled out.
+ * Returns the number of strands signalled.
  */
 int
-shm_callout_register(uperf_shm_t *shm, hrtime_t stop, int group_id)
+shm_process_callouts(uperf_shm_t *shm)
 {
-	if (shm->callouts[group_id] == 0) {
-		shm->callouts[group_id] = (hrtime_t) stop/CALLOUT_GRANURALITY;
-		return (0);
+	int i;
+	int called_out = 0;
+	hrtime_t now;
+
+	now = GETHRTIME();
+	for (i = 0; i < shm->no_strands; i++) {
+		strand_t *s = shm_get_strand(shm, i);
+		hrtime_t deadline = s->deadline;
+
+		if (deadline == 0 || now < deadline + CALLOUT_GRACE ||
+		    !STRAND_EXECUTING(s))
+			continue;
+		s->signalled = 1;
+		(void) signal_strand(s, SIGUSR2);
+		called_out++;
 	}
-	/* Callout already registered!. Should not happen */
-	return (-1);
+	if (called_out > 0)
+		uperf_info("called out %d strands\n", called_out);
+
+	return (called_out);
 }
 
 /*
- * Returns 0 if no callouts
- * 	-1 if error
- * 	x if called out
+ * End the current duration txn of every strand still running one by
+ * pulling its deadline in to "now". The strand clears its deadline
+ * (CLEAR_SIGNAL) and sets the next one without us, so the deadline is
+ * only replaced if it is still the one we read.
  */
-int
-shm_process_callouts(uperf_shm_t *shm)
+void
+shm_stop_strands(uperf_shm_t *shm, hrtime_t now)
 {
 	int i;
-	int no_groups;
-	int called_out = 0;
-	hrtime_t now;
 
-	if (shm->role == MASTER)
-		no_groups = shm->workorder->ngrp;
-	else
-		no_groups = 1;
-
-	now = (hrtime_t) GETHRTIME()/CALLOUT_GRANURALITY;
-	for (i = 0; i < no_groups; i++) {
-		hrtime_t timeout = shm->callouts[i];
-
-		if (timeout > 0 && timeout <= now) {
-			if (signal_all_strands(shm, i, SIGUSR2) != 0) {
-				shm->global_error++;
-				uperf_log_msg(UPERF_LOG_ERROR, 0,
-				    "Error signalling strands");
-				return (-1);
-			}
-			shm->callouts[i] = 0;
-			called_out++;
-			uperf_info("called out\n");
-		}
-	}
+	for (i = 0; i < shm->no_strands; i++) {
+		strand_t *s = shm_get_strand(shm, i);
+		hrtime_t deadline = s->deadline;
 
-	return (called_out);
+		if (deadline <= now)
+			continue;
+#ifdef HAVE_ATOMIC_H
+		(void) atomic_cas_64((volatile uint64_t *)&s->deadline,
+		    deadline, now);
+#else
+		(void) __sync_bool_compare_and_swap(&s->deadline, deadline,
+		    now);
+#endif /* HAVE_ATOMIC_H */
+	}
 }
+
 /*
  * Initialize and prime all barriers for the master.
  * shm->bar[i] is used with "i"th transaction.
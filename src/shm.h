@@ -85,9 +85,8 @@ struct uperf_shm {
 #endif /* HAVE_STDATOMIC_H */
 	int cleaned_up;
 
-	/* callouts */
-	hrtime_t callouts[MAXTHREADGROUPS];
 	hrtime_t txn_begin;
+	uint64_t listen_overflows;	/* Host's count when sharding began */
 	
 	/* per thread structures */
 	protocol_t **connection_list;
@@ -105,8 +104,8 @@ int shm_init_barriers_master(uperf_shm_t *shm, workorder_t *w);
 void flag_error(char *reason);
 int shm_init_barriers_slave(uperf_shm_t *shm, group_t *g);
 int bump_global_xfer(uint64_t val);
-int shm_callout_register(uperf_shm_t *, hrtime_t, int);
 int shm_process_callouts(uperf_shm_t *);
+void shm_stop_strands(uperf_shm_t *, hrtime_t);
 void shm_update_strand_exit(uperf_shm_t *);
 newstats_t * malloc_newstats(uperf_shm_t *, stats_type_t, int, int, int, int, char *);
 
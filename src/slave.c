@@ -64,6 +64,8 @@
 #include "common.h"
 #include "generic.h"
 #include "stats.h"
+#include "affinity.h"
+#include "compute.h"
 
 extern options_t options;
 static uperf_log_t log;
@@ -76,10 +78,16 @@ slave_spawn_strands(uperf_shm_t *shm, protocol_t *control)
 {
 	int i;
 
+	if (compute_calibrate(shm->worklist) != UPERF_SUCCESS) {
+		slave_handshake_p2_failure("Error calibrating compute",
+		    control, 0);
+		uperf_fatal("Quitting\n");
+	}
 	for (i = 0; i < shm->worklist->nthreads; i++) {
 		int status;
 		strand_t *s = shm_get_strand(shm, i);
 		s->role = SLAVE;
+		s->sid = i;
 		s->worklist = group_clone(shm->worklist);
 		s->shmptr = shm;
 		status = pthread_create(&s->tid, NULL, &strand_run, s);
@@ -97,23 +105,38 @@ slave_spawn_strands(uperf_shm_t *shm, protocol_t *control)
 }
 
 /*
- * Wait (for a max of 5s) for threads to reach a barrier, and unlock it
+ * Wait (for a max of 5s) for threads to reach a barrier, and unlock it.
+ * early is set if the master ended the last txn before its time (-c).
  */
 static int
-wait_unlock_barrier(uperf_shm_t *shm, int txn)
+wait_unlock_barrier(uperf_shm_t *shm, int txn, int early)
 {
 	int wait_time = 5;
 	char msg[128];
 	barrier_t *bar;
+	hrtime_t stop, now;
 
 	if (txn > shm->worklist->ntxn)
 		return (0);
 
 	bar = &shm->bar[txn];
+	/*
+	 * The master's strands are done, and ours end duration txns at
+	 * about the same time by themselves. If the master ended the txn
+	 * early, so do we. Only signal the ones that do not show up
+	 * within a second.
+	 */
+	now = GETHRTIME();
+	if (early)
+		shm_stop_strands(shm, now);
+	stop = now + 1.0e+9;
+	while (BARRIER_NOTREACHED(bar) && (now = GETHRTIME()) < stop)
+		(void) barrier_wait_reached(bar, (stop - now) / 1000000 + 1);
 	while (BARRIER_NOTREACHED(bar)) {
-		uperf_log_flush();
+		/* A strand failed: keep its errors for the goodbye */
 		if (shm->global_error > 0)
 			return (-1);
+		uperf_log_flush();
 
 		uperf_info("%d threads not at barrier %d sending SIGUSR2\n",
 		    barrier_notreached(bar), txn);
@@ -173,7 +196,9 @@ slave_master_poll(uperf_shm_t *shm, protocol_t *control)
 			if (uc.command == UPERF_CMD_NEXT_TXN) {
 				/* Unlock this barrier */
 				shm->txn_begin = GETHRTIME();
-				if (wait_unlock_barrier(shm, uc.value) != 0) {
+				if (wait_unlock_barrier(shm,
+				    uc.value & ~UPERF_TXN_EARLY,
+				    (uc.value & UPERF_TXN_EARLY) != 0) != 0) {
 					return (-1);
 				}
 			} else if (uc.command == UPERF_CMD_ABORT) {
@@ -215,6 +240,9 @@ slave_master_goodbye(uperf_shm_t *shm, protocol_t *control)
 		uperf_log_flush_to_string(goodbye.message,
 			GOODBYE_MESSAGE_LEN);
 		uperf_info("Goodbye **  %s ***\n", goodbye.message);
+	} else if (accept_report(shm, goodbye.gstat.elapsed_time,
+	    goodbye.message, GOODBYE_MESSAGE_LEN) > 0) {
+		goodbye.msg_type = MESSAGE_REPORT;
 	} else {
 		goodbye.msg_type = MESSAGE_INFO;
 		(void) strlcpy(goodbye.message, "Success", GOODBYE_MESSAGE_LEN);
@@ -349,6 +377,11 @@ slave_master(protocol_t *p)
 	}
 	wait_for_strands(shm, error);
 	newstat_end(0, AGG_STAT(shm), 0, 0);
+	if (shm->worklist->slave_cpus[0] != '\0' ||
+	    shm->worklist->placement != GROUP_PLACE_ANY)
+		print_strand_cpus(shm);
+	/* Warmups and cooldowns are not part of the measured run time */
+	AGG_STAT(shm)->start_time += group_unmeasured(shm->worklist);
 
 	/*
 	 * We can either send the UPERF_CMD_ABORT or goodbye_stat_t
@@ -54,44 +54,116 @@
 #define	SA	struct sockaddr	/* typecasts of pointer arguments: */
 #define	SOCK_PORT(sin) ((sin).sin_port)
 #define	PASS  "password"
+#define	SSL_EARLY_DATA_MAX	16384
 
 /* Structure private to the ssl protocol */
 typedef struct ssl_private {
 	SSL *ssl;
+	SSL_CTX *ctx;	/* Listener context, shared by accepted connections */
+	int resume;	/* Wait for the peer on shutdown to collect tickets */
 } ssl_private_t;
 
+/*
+ * SSL contexts are built from the flowop options (method, cipher,
+ * engine, tickets) and cached per strand. Strands never share a
+ * context, so there is no contention on the session cache or the
+ * context reference count during handshakes. With the resume option,
+ * the last session handed out by the server is kept in the cache entry
+ * and offered on the next connect.
+ */
+typedef struct ssl_ctx_cache {
+	char method[sizeof (((flowop_options_t *)0)->method)];
+	char cipher[sizeof (((flowop_options_t *)0)->cipher)];
+	char engine[sizeof (((flowop_options_t *)0)->engine)];
+	uint32_t flag;
+	SSL_CTX *ctx;
+	SSL_SESSION *session;
+	struct ssl_ctx_cache *next;
+} ssl_ctx_cache_t;
+
+#define	SSL_CTX_FLAGS	(O_SSL_NO_TICKETS | O_SSL_RESUME)
+
 extern options_t options;
 
 static protocol_t *protocol_ssl_new();
 /* Utility functions */
-static SSL_CTX *initialize_ctx(char *keyfile, char *password,
-	const char *method);
+static SSL_CTX *initialize_ctx(char *keyfile, flowop_options_t *fo);
 static int pwd_cb(char *buf, int num, int rwflag, void *userdata);
 static int load_engine(const char *engine_id);
-static SSL_CTX *ctx;
 
-
-/*
- * Openssl is not threadsafe if we do not provide the following
- * two callbacks
- */
-
-static pthread_mutex_t *ssl_locks;
+static char keyfile[PATHMAX];
+static pthread_key_t ctx_key;
+static const char early_data[SSL_EARLY_DATA_MAX];
 
 static void
-locking_function(int mode, int n, char *file, int line)
+ssl_ctx_cache_free(void *arg)
 {
-	if (mode & CRYPTO_LOCK) {
-		(void) pthread_mutex_lock(&(ssl_locks[n]));
-	} else {
-		(void) pthread_mutex_unlock(&(ssl_locks[n]));
+	ssl_ctx_cache_t *c = arg;
+	ssl_ctx_cache_t *next;
+
+	while (c != NULL) {
+		next = c->next;
+		if (c->session != NULL)
+			SSL_SESSION_free(c->session);
+		SSL_CTX_free(c->ctx);
+		free(c);
+		c = next;
 	}
 }
 
-static unsigned long
-id_function(void)
+/* Client side: remember the latest session for the next connect */
+static int
+ssl_new_session(SSL *ssl, SSL_SESSION *session)
 {
-	return ((unsigned long) MY_THREAD_ID());
+	ssl_ctx_cache_t *c = SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+
+	if (c == NULL || !SSL_SESSION_is_resumable(session))
+		return (0);
+	if (c->session != NULL)
+		SSL_SESSION_free(c->session);
+	c->session = session;
+
+	return (1);
+}
+
+/* Return this strand's context matching the options, create if needed */
+static SSL_CTX *
+ssl_get_ctx(flowop_options_t *fo)
+{
+	ssl_ctx_cache_t *head, *c;
+	flowop_options_t def;
+	uint32_t flag;
+
+	if (fo == NULL) {
+		bzero(&def, sizeof (def));
+		fo = &def;
+	}
+	flag = fo->flag & SSL_CTX_FLAGS;
+
+	head = pthread_getspecific(ctx_key);
+	for (c = head; c != NULL; c = c->next) {
+		if (c->flag == flag && strcmp(c->method, fo->method) == 0 &&
+		    strcmp(c->cipher, fo->cipher) == 0 &&
+		    strcmp(c->engine, fo->engine) == 0)
+			return (c->ctx);
+	}
+	if ((c = calloc(1, sizeof (ssl_ctx_cache_t))) == NULL) {
+		perror("calloc");
+		return (NULL);
+	}
+	if ((c->ctx = initialize_ctx(keyfile, fo)) == NULL) {
+		free(c);
+		return (NULL);
+	}
+	(void) strlcpy(c->method, fo->method, sizeof (c->method));
+	(void) strlcpy(c->cipher, fo->cipher, sizeof (c->cipher));
+	(void) strlcpy(c->engine, fo->engine, sizeof (c->engine));
+	c->flag = flag;
+	c->next = head;
+	(void) SSL_CTX_set_app_data(c->ctx, c);
+	(void) pthread_setspecific(ctx_key, c);
+
+	return (c->ctx);
 }
 
 static int
@@ -147,32 +219,36 @@ ssl_cleanup(void)
 int
 ssl_init(void *arg)
 {
+	SSL_CTX *ctx;
+	char *files[2];
 	int i;
 
 	if (IS_MASTER(options)) {
-		if (file_present("server.pem") == 0)
-			ctx = initialize_ctx("server.pem", PASS, NULL);
-		else if (file_present("../server.pem") == 0)
-			ctx = initialize_ctx("../server.pem", PASS, NULL);
-		else
-			printf("Can't load server.pem\n");
+		files[0] = "server.pem";
+		files[1] = "../server.pem";
 	} else {
-		if (file_present("client.pem") == 0)
-			ctx = initialize_ctx("client.pem", PASS, NULL);
-		else if (file_present("../client.pem") == 0)
-			ctx = initialize_ctx("../client.pem", PASS, NULL);
-		else
-			printf("Can't load client.pem\n");
+		files[0] = "client.pem";
+		files[1] = "../client.pem";
+	}
+	for (i = 0; i < 2; i++) {
+		if (file_present(files[i]) == 0) {
+			(void) strlcpy(keyfile, files[i], sizeof (keyfile));
+			break;
+		}
 	}
-	if (ctx == NULL)
+	if (keyfile[0] == '\0') {
+		printf("Can't load %s\n", files[0]);
 		return (1);
+	}
+	/* Validate the key file once; strands build their own contexts */
+	if ((ctx = initialize_ctx(keyfile, NULL)) == NULL)
+		return (1);
+	SSL_CTX_free(ctx);
 
-	ssl_locks = malloc(CRYPTO_num_locks() * sizeof (pthread_mutex_t));
-	for (i = 0; i < CRYPTO_num_locks(); i++) {
-		pthread_mutex_init(&ssl_locks[i], 0);
+	if (pthread_key_create(&ctx_key, ssl_ctx_cache_free) != 0) {
+		ulog_err("pthread_key_create");
+		return (1);
 	}
-	CRYPTO_set_id_callback((unsigned long (*)())id_function);
-	CRYPTO_set_locking_callback((void (*)())locking_function);
 
 	/*
 	 * We also register an atexit function to cleanup the ENGINE
@@ -203,6 +279,7 @@ ssl_write(SSL *ssl, char *ptr, size_t n)
 static int
 protocol_ssl_listen(protocol_t *p, void *o)
 {
+	ssl_private_t *ssl_p = (ssl_private_t *) p->_protocol_p;
 	char msg[128];
 
 	if (generic_socket(p, AF_INET6, IPPROTO_TCP) != UPERF_SUCCESS) {
@@ -214,6 +291,16 @@ protocol_ssl_listen(protocol_t *p, void *o)
 	}
 	set_tcp_options(p->fd, (flowop_options_t *)o);
 
+	/*
+	 * The listener owns its context so that all connections accepted
+	 * on it can resume sessions and decrypt tickets it issued.
+	 */
+	if ((ssl_p->ctx = initialize_ctx(keyfile, o)) == NULL) {
+		return (UPERF_FAILURE);
+	}
+	/* Allow 0-RTT from any connect that uses early_data */
+	(void) SSL_CTX_set_max_early_data(ssl_p->ctx, SSL_EARLY_DATA_MAX);
+
 	return (generic_listen(p, IPPROTO_TCP, o));
 }
 
@@ -228,6 +315,7 @@ protocol_ssl_accept(protocol_t *p, void *options)
 	char hostname[128];
 	flowop_options_t *flowop_options = (flowop_options_t *) options;
 	BIO *sbio;
+	SSL_CTX *ctx;
 
 	newp = protocol_ssl_new();
 	new_ssl_p = (ssl_private_t *) newp->_protocol_p;
@@ -246,12 +334,9 @@ protocol_ssl_accept(protocol_t *p, void *options)
 		strlcpy(newp->host, hostname, sizeof (newp->host));
 		newp->port = SOCK_PORT(remote);
 	}
-	if (flowop_options) {
-		if ((load_engine(flowop_options->engine)) == -1) {
-			uperf_info(
-"ssl - Engine %s does NOT exist! Using the default OpenSSL softtoken",
-			flowop_options->engine);
-		}
+	if ((ctx = ((ssl_private_t *)p->_protocol_p)->ctx) == NULL) {
+		if ((ctx = ssl_get_ctx(flowop_options)) == NULL)
+			return (NULL);
 	}
 	sbio = BIO_new_socket(newp->fd, BIO_NOCLOSE);
 	if (!(new_ssl_p->ssl = SSL_new(ctx))) {
@@ -260,6 +345,22 @@ protocol_ssl_accept(protocol_t *p, void *options)
 	}
 	SSL_set_bio(new_ssl_p->ssl, sbio, sbio);
 
+	/* Drain 0-RTT data; this also completes the handshake */
+	if (flowop_options && FO_SSL_EARLY_DATA(flowop_options)) {
+		char buf[4096];
+		size_t nread;
+
+		SSL_set_accept_state(new_ssl_p->ssl);
+		do {
+			ret = SSL_read_early_data(new_ssl_p->ssl, buf,
+			    sizeof (buf), &nread);
+		} while (ret == SSL_READ_EARLY_DATA_SUCCESS);
+		if (ret == SSL_READ_EARLY_DATA_ERROR) {
+			uperf_log_msg(UPERF_LOG_ERROR, 0,
+			    "ssl - error reading early data");
+			return (NULL);
+		}
+	}
 	ret = SSL_accept(new_ssl_p->ssl);
 	if (my_ssl_error(new_ssl_p->ssl, ret) == 0) {
 		return (newp);
@@ -273,6 +374,9 @@ protocol_ssl_connect(protocol_t *p, void *options)
 {
 	struct sockaddr_storage serv;
 	BIO *sbio;
+	SSL_CTX *ctx;
+	ssl_ctx_cache_t *cache;
+	SSL_SESSION *session = NULL;
 	int status;
 
 	ssl_private_t *ssl_p = (ssl_private_t *) p->_protocol_p;
@@ -291,13 +395,8 @@ protocol_ssl_connect(protocol_t *p, void *options)
 	if (generic_connect(p, &serv) < 0) {
 		return (UPERF_FAILURE);
 	}
-	if (flowop_options && (strcmp(flowop_options->engine, ""))) {
-		status = load_engine(flowop_options->engine);
-		if (status == -1) {
-			uperf_info(
-"ssl - Engine %s does NOT exist! Using the default OpenSSL softtoken",
-			flowop_options->engine);
-		}
+	if ((ctx = ssl_get_ctx(flowop_options)) == NULL) {
+		return (UPERF_FAILURE);
 	}
 	if ((ssl_p->ssl = SSL_new(ctx)) == NULL) {
 		ulog_err("Error initializng SSL");
@@ -306,11 +405,47 @@ protocol_ssl_connect(protocol_t *p, void *options)
 	sbio = BIO_new_socket(p->fd, BIO_NOCLOSE);
 	SSL_set_bio(ssl_p->ssl, sbio, sbio);
 
+	if (flowop_options && FO_SSL_RESUME(flowop_options)) {
+		cache = SSL_CTX_get_app_data(ctx);
+		session = cache->session;
+		ssl_p->resume = 1;
+	}
+	if (session != NULL)
+		(void) SSL_set_session(ssl_p->ssl, session);
+	if (session != NULL && FO_SSL_EARLY_DATA(flowop_options) &&
+	    SSL_SESSION_get_max_early_data(session) > 0) {
+		size_t len, written;
+
+		SSL_set_connect_state(ssl_p->ssl);
+		len = MIN(MAX(flowop_options->size, 1), SSL_EARLY_DATA_MAX);
+		if (SSL_write_early_data(ssl_p->ssl, early_data, len,
+		    &written) != 1) {
+			uperf_log_msg(UPERF_LOG_ERROR, 0,
+			    "ssl - error writing early data");
+			return (-1);
+		}
+	}
+
 	status = SSL_connect(ssl_p->ssl);
 	if (status <= 0) {
 		uperf_log_msg(UPERF_LOG_ERROR, 0, "ssl connect error");
 		return (-1);
 	}
+	/*
+	 * Fail if an offered session or 0-RTT data was not accepted, so
+	 * that stats of resumed handshakes never include full ones.
+	 */
+	if (session != NULL && !SSL_session_reused(ssl_p->ssl)) {
+		uperf_log_msg(UPERF_LOG_ERROR, 0, "ssl - session not resumed");
+		return (-1);
+	}
+	if (session != NULL && FO_SSL_EARLY_DATA(flowop_options) &&
+	    SSL_get_early_data_status(ssl_p->ssl) !=
+	    SSL_EARLY_DATA_ACCEPTED) {
+		uperf_log_msg(UPERF_LOG_ERROR, 0,
+		    "ssl - early data not accepted");
+		return (-1);
+	}
 	return (0);
 }
 
@@ -330,7 +465,7 @@ protocol_ssl_disconnect(protocol_t *p)
 	if (ssl_p->ssl != NULL) {
 		r = SSL_shutdown(ssl_p->ssl);
 
-		if ((!r) && (IS_SLAVE(options))) {
+		if ((!r) && (IS_SLAVE(options) || ssl_p->resume)) {
 			shutdown(p->fd, 1);
 			r = SSL_shutdown(ssl_p->ssl);
 		}
@@ -345,10 +480,15 @@ protocol_ssl_disconnect(protocol_t *p)
 			return (-1);
 		}
 
-		if (!ssl_p->ssl)
-			SSL_free(ssl_p->ssl);
+		SSL_free(ssl_p->ssl);
+		ssl_p->ssl = NULL;
 	}			/* workaround ends */
-	return (close(p->fd));
+	if (p->fd >= 0) {
+		r = close(p->fd);
+		p->fd = -1;
+		return (r);
+	}
+	return (0);
 }
 
 static int
@@ -382,22 +522,32 @@ protocol_ssl_undefined(protocol_t *p, void *options)
 }
 
 
-SSL_CTX *
-initialize_ctx(char *keyfile, char *password, const char *method)
+static SSL_CTX *
+initialize_ctx(char *keyfile, flowop_options_t *fo)
 {
-#if OPENSSL_VERSION_NUMBER > 0x000908fff
 	const SSL_METHOD *meth;
-#else
-	SSL_METHOD *meth;
-#endif
 	SSL_CTX *ctx;
+	char *method = "";
+	int version = 0;
+
+	if (fo != NULL)
+		method = fo->method;
+	meth = TLS_method();
+	if (strcasecmp(method, "tls1.2") == 0) {
+		version = TLS1_2_VERSION;
+#ifdef TLS1_3_VERSION
+	} else if (strcasecmp(method, "tls1.3") == 0) {
+		version = TLS1_3_VERSION;
+#endif
+	}
 
-	SSL_library_init();
-
-	if (method != NULL && strcasecmp(method, "tls") == 0) {
-		meth = TLS_method();
-	} else
-		meth = SSLv23_method();
+	if (fo != NULL && fo->engine[0] != '\0') {
+		if (load_engine(fo->engine) == -1) {
+			uperf_info(
+"ssl - Engine %s does NOT exist! Using the default OpenSSL softtoken",
+			fo->engine);
+		}
+	}
 
 	if (!(ctx = SSL_CTX_new(meth))) {
 		printf("Error getting SSL CTX\n");
@@ -405,18 +555,48 @@ initialize_ctx(char *keyfile, char *password, const char *method)
 	}
 	if (!SSL_CTX_use_certificate_chain_file(ctx, keyfile)) {
 		printf("Error getting SSL CTX:1\n");
+		SSL_CTX_free(ctx);
 		return (0);
 	}
 	SSL_CTX_set_default_passwd_cb(ctx, pwd_cb);
 
 	if (!SSL_CTX_use_PrivateKey_file(ctx, keyfile, SSL_FILETYPE_PEM)) {
 		printf("Error getting SSL CTX:2\n");
+		SSL_CTX_free(ctx);
 		return (0);
 	}
 	if (!SSL_CTX_check_private_key(ctx)) {
 		printf("Error getting SSL CTX:3\n");
+		SSL_CTX_free(ctx);
 		return (0);
 	}
+	if (version != 0) {
+		(void) SSL_CTX_set_min_proto_version(ctx, version);
+		(void) SSL_CTX_set_max_proto_version(ctx, version);
+	}
+	if (fo != NULL && fo->cipher[0] != '\0') {
+		int ret;
+
+		/* TLS 1.3 suites are configured separately from older ciphers */
+#ifdef TLS1_3_VERSION
+		if (strncmp(fo->cipher, "TLS_", 4) == 0)
+			ret = SSL_CTX_set_ciphersuites(ctx, fo->cipher);
+		else
+#endif
+			ret = SSL_CTX_set_cipher_list(ctx, fo->cipher);
+		if (ret == 0) {
+			printf("Unsupported cipher %s\n", fo->cipher);
+			SSL_CTX_free(ctx);
+			return (0);
+		}
+	}
+	if (fo != NULL && FO_SSL_NO_TICKETS(fo))
+		SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+	(void) SSL_CTX_set_session_id_context(ctx, (unsigned char *)"uperf", 5);
+	if (fo != NULL && FO_SSL_RESUME(fo)) {
+		(void) SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_BOTH);
+		SSL_CTX_sess_set_new_cb(ctx, ssl_new_session);
+	}
 
 	return (ctx);
 }
@@ -464,6 +644,7 @@ protocol_ssl_new()
 		return (NULL);
 	}
 	newp->_protocol_p = new_ssl_p;
+	newp->fd = -1;
 	newp->connect = protocol_ssl_connect;
 	newp->disconnect = protocol_ssl_disconnect;
 	newp->listen = protocol_ssl_listen;
@@ -501,6 +682,9 @@ ssl_fini(protocol_t *p)
 	}
 	protocol_ssl_disconnect(p);
 	if (p->_protocol_p) {
+		ssl_private_t *ssl_p = (ssl_private_t *) p->_protocol_p;
+		if (ssl_p->ctx != NULL)
+			SSL_CTX_free(ssl_p->ctx);
 		free(p->_protocol_p);
 	}
 	free(p);
@@ -86,6 +86,17 @@ GETHRTIME()
 
 #ifdef HAVE_GETHRVTIME
 #define	GETHRVTIME gethrvtime
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+uint64_t
+GETHRVTIME()
+{
+	struct timespec now;
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) != 0)
+		return (0);
+
+	return (now.tv_sec * 1000000000LL + now.tv_nsec);
+}
 #else
 uint64_t
 GETHRVTIME()
@@ -94,6 +105,61 @@ GETHRVTIME()
 }
 #endif /* HAVE_GETHRVTIME */
 
+static int
+hist_bucket(uint64_t v)
+{
+	int msb = 0;
+	int b;
+
+	if (v < NSTAT_HIST_SUB)
+		return ((int)v);
+	while ((v >> (msb + 1)) != 0)
+		msb++;
+	b = (msb - NSTAT_HIST_SHIFT + 1) * NSTAT_HIST_SUB +
+	    (int)((v >> (msb - NSTAT_HIST_SHIFT)) & (NSTAT_HIST_SUB - 1));
+
+	return (MIN(b, NSTAT_HIST_BUCKETS - 1));
+}
+
+/* Midpoint of the values that fall in bucket b */
+static uint64_t
+hist_value(int b)
+{
+	int shift;
+
+	if (b < NSTAT_HIST_SUB)
+		return (b);
+	shift = b / NSTAT_HIST_SUB - 1;
+
+	return (((uint64_t)(NSTAT_HIST_SUB + b % NSTAT_HIST_SUB) << shift) +
+	    ((1ULL << shift) >> 1));
+}
+
+/* Latency (ns) below which pct percent of the samples fall */
+uint64_t
+stats_percentile(newstats_t *ns, double pct)
+{
+	uint64_t total = 0;
+	uint64_t sum = 0;
+	uint64_t want;
+	int i;
+
+	for (i = 0; i < NSTAT_HIST_BUCKETS; i++)
+		total += ns->hist[i];
+	if (total == 0)
+		return (0);
+	want = (uint64_t)(total * pct / 100.0 + 0.5);
+	if (want == 0)
+		want = 1;
+	for (i = 0; i < NSTAT_HIST_BUCKETS; i++) {
+		sum += ns->hist[i];
+		if (sum >= want)
+			return (MIN(MAX(hist_value(i), ns->min), ns->max));
+	}
+
+	return (ns->max);
+}
+
 /* ARGSUSED */
 int
 newstat_begin(strand_t *s, newstats_t *ns, uint64_t size, uint64_t count)
@@ -124,13 +190,14 @@ newstat_end(strand_t *s, newstats_t *ns, uint64_t size, uint64_t count)
 
 	ns->end_time = GETHRTIME();
 	if (ENABLED_UTILIZATION_STATS(options))
-		ns->cpu_time_start = GETHRVTIME();
-	ns->size += size;
+		ns->cpu_time += GETHRVTIME() - ns->cpu_time_start;
+	ns->size += size * count;
 	ns->count += count;
 	delta = ns->end_time - ns->time_used_start;
 	ns->time_used += delta;
 	ns->max = MAX(ns->max, delta);
 	ns->min = MIN(ns->min, delta);
+	ns->hist[hist_bucket(delta)]++;
 #ifdef USE_CPC
 	if (s && ENABLED_CPUCOUNTER_STATS(options)) {
 		hwcounter_snap(&s->hw, SNAP_END);
@@ -141,12 +208,36 @@ newstat_end(strand_t *s, newstats_t *ns, uint64_t size, uint64_t count)
 	return (0);
 }
 
+/*
+ * Nothing is recorded during the warmup and cooldown of a duration
+ * txn: an op counts only if it both begins and ends between them.
+ */
+int
+stats_measured(int type, strand_t *s, newstats_t *stats)
+{
+	hrtime_t now;
+
+	if (s == NULL || s->measure_end == 0)
+		return (1);
+	now = GETHRTIME();
+	if (now < s->measure_start || now > s->measure_end)
+		return (0);
+	if (type == FLOWOP_END || type == TXN_END)
+		return (stats == NULL ||
+		    stats->time_used_start >= s->measure_start);
+
+	return (1);
+}
+
 int
 stats_update(int type, strand_t *s, newstats_t *stats, uint64_t size,
     uint64_t count)
 {
 	if (DISABLED_STATS(options))
 		return (0);
+	if (type != GROUP_BEGIN && type != GROUP_END &&
+	    !stats_measured(type, s, stats))
+		return (0);
 
 	switch (type) {
 
@@ -156,6 +247,9 @@ stats_update(int type, strand_t *s, newstats_t *stats, uint64_t size,
 		    ENABLED_HISTORY_STATS(options)) {
 			return (newstat_begin(s, stats, 0, 0));
 		}
+		/* FLOWOP_END still needs it to check the window */
+		if (stats != NULL && s != NULL && s->measure_end != 0)
+			stats->time_used_start = GETHRTIME();
 		return (0);
 	case FLOWOP_END:
 		/* We update the strand stats instead of having a global one */
@@ -198,12 +292,23 @@ stats_update(int type, strand_t *s, newstats_t *stats, uint64_t size,
 void
 add_stats(newstats_t *s1, newstats_t *s2)
 {
+	int i;
+
 	s1->count += s2->count;
 	s1->time_used += s2->time_used;
 	s1->cpu_time += s2->cpu_time;
 	s1->size += s2->size;
 	s1->pic0 += s2->pic0;
 	s1->pic1 += s2->pic1;
+	s1->spin_time += s2->spin_time;
+	s1->syscalls += s2->syscalls;
+	s1->touch_time += s2->touch_time;
+	s1->think_req += s2->think_req;
+	s1->think_time += s2->think_time;
+	s1->compute_req += s2->compute_req;
+	s1->compute_time += s2->compute_time;
+	for (i = 0; i < NSTAT_HIST_BUCKETS; i++)
+		s1->hist[i] += s2->hist[i];
 
 	s1->start_time = MIN(s1->start_time, s2->start_time);
 	s1->end_time = MAX(s1->end_time, s2->end_time);
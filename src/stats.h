@@ -39,6 +39,14 @@
 #define	AGG_STAT_NAME	"Total"
 #define	UPERF_NAME_LEN	32
 
+/*
+ * Latency histogram: log2 buckets, each split into NSTAT_HIST_SUB
+ * linear sub-buckets. Covers 0ns to ~1100s with 25% resolution.
+ */
+#define	NSTAT_HIST_SHIFT	2
+#define	NSTAT_HIST_SUB		(1 << NSTAT_HIST_SHIFT)
+#define	NSTAT_HIST_BUCKETS	((40 - NSTAT_HIST_SHIFT + 1) * NSTAT_HIST_SUB)
+
 typedef enum {
 	NSTAT_FLOWOP,
 	NSTAT_TXN,
@@ -60,6 +68,14 @@ typedef struct _newstats_t {
 	uint64_t cpu_time;
 	uint64_t pic0;
 	uint64_t pic1;
+	uint64_t spin_time;	/* Part of time_used spent busy-polling */
+	uint64_t syscalls;	/* I/O syscalls issued */
+	uint64_t touch_time;	/* Part of time_used spent touching data */
+	uint64_t think_req;	/* Think time asked for */
+	uint64_t think_time;	/* Think time actually taken */
+	uint64_t compute_req;	/* Compute time it takes when idle */
+	uint64_t compute_time;	/* Compute time actually taken */
+	uint64_t hist[NSTAT_HIST_BUCKETS];	/* Latency histogram */
 	stats_type_t type;	/* Type (FLOWOP, TXN, GROUP, STRAND, OVERALL) */
 	uint32_t sid;	/* Strand id */
 	uint32_t gid;	/* Group id */
@@ -72,9 +88,11 @@ typedef struct _newstats_t {
     if (ENABLED_STATS(options)) \
 	 stats_update((A), (S), (F), (B), (C));
 int stats_update(int type, strand_t *s, newstats_t *stat, uint64_t, uint64_t);
+int stats_measured(int, strand_t *, newstats_t *);
 int newstat_begin(strand_t *, newstats_t *, uint64_t, uint64_t);
 int newstat_end(strand_t *, newstats_t *, uint64_t, uint64_t);
 void add_stats(newstats_t *s1, newstats_t *s2);
+uint64_t stats_percentile(newstats_t *, double);
 void update_aggr_stat(uperf_shm_t *shm);
 
 
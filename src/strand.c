@@ -39,6 +39,7 @@
 #include "delay.h"
 #include "main.h"
 #include "signals.h"
+#include "affinity.h"
 
 int group_execute(strand_t *, group_t *);
 extern options_t options;
@@ -65,9 +66,10 @@ strand_init_group(uperf_shm_t *shm, group_t *g, int ssid)
 		(void) bzero(st, sizeof (strand_t));
 		snprintf(STRAND_STAT(st)->name, UPERF_NAME_LEN, "Thr%d", j);
 		STRAND_STAT(st)->type = NSTAT_STRAND;
-		(void) bzero(st->ccache, sizeof (st->ccache));
+		st->ctable = NULL;
+		st->ctable_size = 0;
+		st->nconnections = 0;
 		st->cpool = NULL;
-		st->ccache_size = 0;
 
 		if (j == 0)
 			st->strand_flag |= STRAND_LEADER;
@@ -129,82 +131,104 @@ strand_get_port(strand_t *s, char *host, int protocol)
 	return (-1);
 }
 
+/*
+ * A strand's connections are kept in cpool and in a hash table on
+ * their id, which is what the flowops look them up by. Several
+ * connections can share an id (nconns, or accepting in a loop); the
+ * newest comes first in its bucket, as in cpool.
+ */
+#define	CTABLE_BUCKET(s, id)	\
+	(&(s)->ctable[(uint32_t)(id) & ((s)->ctable_size - 1)])
+
+static int
+strand_ctable_grow(strand_t *s)
+{
+	protocol_t **bucket;
+	protocol_t **t;
+	protocol_t *p;
+	int size = s->ctable_size ? 2 * s->ctable_size : STRAND_CTABLE_MIN;
+
+	if ((t = calloc(size, sizeof (protocol_t *))) == NULL)
+		return (UPERF_FAILURE);
+	free(s->ctable);
+	s->ctable = t;
+	s->ctable_size = size;
+	/* Oldest first, so that the newest ends up in front */
+	for (p = s->cpool; p != NULL && p->next != NULL; p = p->next)
+		;
+	for (; p != NULL; p = p->prev) {
+		bucket = CTABLE_BUCKET(s, p->p_id);
+		p->hnext = *bucket;
+		*bucket = p;
+	}
+
+	return (UPERF_SUCCESS);
+}
+
 int
 strand_add_connection(strand_t *s, protocol_t *p)
 {
+	protocol_t **bucket;
+
+	/* Keep the buckets short; a full table still works if need be */
+	if (s->nconnections >= s->ctable_size &&
+	    strand_ctable_grow(s) != UPERF_SUCCESS && s->ctable == NULL) {
+		ulog_err("Cannot allocate the connection table");
+		return (1);
+	}
+	p->prev = NULL;
 	p->next = s->cpool;
 	if (s->cpool)
 		s->cpool->prev = p;
 	s->cpool = p;
+	bucket = CTABLE_BUCKET(s, p->p_id);
+	p->hnext = *bucket;
+	*bucket = p;
+	s->nconnections++;
+
 	return (0);
 }
 
 int
 strand_delete_connection(strand_t *s, int id)
 {
-	protocol_t *ptr = s->cpool;
-	while (ptr) {
-		if (ptr->p_id == id) {
-			if (ptr->prev)
-				ptr->prev->next = ptr->next;
-			if (ptr->next)
-				ptr->next->prev = ptr->prev;
-			if (ptr == s->cpool)
-				s->cpool = ptr->next;
-			destroy_protocol(ptr->type, ptr);
-			s->ccache_size = 0;	 /* flush cache */
-			return (0);
-		}
-		ptr = ptr->next;
+	protocol_t **pp;
+	protocol_t *ptr;
+
+	if (s->ctable == NULL)
+		return (1);
+	for (pp = CTABLE_BUCKET(s, id); (ptr = *pp) != NULL;
+	    pp = &ptr->hnext) {
+		if (ptr->p_id != id)
+			continue;
+		*pp = ptr->hnext;
+		if (ptr->prev)
+			ptr->prev->next = ptr->next;
+		if (ptr->next)
+			ptr->next->prev = ptr->prev;
+		if (ptr == s->cpool)
+			s->cpool = ptr->next;
+		s->nconnections--;
+		destroy_protocol(ptr->type, ptr);
+		return (0);
 	}
-	return (1);
-}
 
-void
-strand_put_connection_in_cache(strand_t *s, protocol_t *p)
-{
-	static int current_replacement = 0;
-
-	if (s->ccache_size == STRAND_CONNECTION_CACHE_SIZE - 1) {
-		s->ccache[current_replacement] = p;
-		current_replacement
-		    = (current_replacement + 1)%STRAND_CONNECTION_CACHE_SIZE;
-	} else {
-		s->ccache[s->ccache_size++] = p;
-	}
+	return (1);
 }
 
-/*
- * Get connection for id. If id == UPERF_ANY_CONNECTION, return
- * the first anonymous connection
- */
+/* Get the newest connection with id */
 protocol_t *
 strand_get_connection(strand_t *s, int id)
 {
-	int i;
-	protocol_t *ptr = s->cpool;
+	protocol_t *ptr;
 
 	assert(s);
-	if (!s->cpool)
+	if (s->nconnections == 0)
 		return (NULL);
 
-	/* check cache */
-	for (i = 0; i < s->ccache_size; i++) {
-		if (s->ccache[i] == NULL)
-			continue;
-		if ((s->ccache[i]->p_id == id) || (id == -1)) {
-			return (s->ccache[i]);
-		}
-	}
-	/* cache miss */
-	while (ptr) {
-		if (ptr->p_id == id) {
-			/* Match found, fill in cache before returning */
-			strand_put_connection_in_cache(s, ptr);
+	for (ptr = *CTABLE_BUCKET(s, id); ptr != NULL; ptr = ptr->hnext)
+		if (ptr->p_id == id)
 			return (ptr);
-		}
-		ptr = ptr->next;
-	}
 	printf("No such connection with id %d\n", id);
 	return (NULL);
 }
@@ -234,6 +258,10 @@ strand_fini(strand_t *s)
 		destroy_protocol(p->type, p);
 		p = ptmp;
 	}
+	s->cpool = NULL;
+	free(s->ctable);
+	s->ctable = NULL;
+	s->ctable_size = s->nconnections = 0;
 	sil = s->slave_list;
 	while (sil) {
 		slave_info_list_t *q = sil->next;
@@ -465,10 +493,18 @@ strand_run(void *sp)
 	}
 #endif
 
+	if (strand_bind(s) != UPERF_SUCCESS) {
+		flag_error("Cannot bind strand to its CPUs");
+		shm_update_strand_exit(shm);
+		return (NULL);
+	}
+
 	/* Start transactions */
 	newstat_begin(0, STRAND_STAT(s), 0, 0);
 	error = group_execute(s, s->worklist);
 	newstat_end(0, STRAND_STAT(s), 0, 1);
+	/* Warmups and cooldowns are not part of the measured run time */
+	STRAND_STAT(s)->start_time += group_unmeasured(s->worklist);
 	if (error != UPERF_SUCCESS && error != EINTR) {
 		flag_error("Error executing transactions");
 	}
@@ -19,6 +19,8 @@
 #define	_STRAND_H
 
 #include "uperf.h"
+#include "dist.h"
+#include "bufpool.h"
 #ifdef USE_CPC
 #include "hwcounter.h"
 #endif /* USE_CPC */
@@ -42,11 +44,31 @@ typedef enum {
 #define	STRAND_EXECUTING(s)	((s)->strand_state == STRAND_STATE_EXECUTING)
 #define	STRAND_EXIT(s)	((s)->strand_state == STRAND_STATE_EXIT)
 
-#define SIGNALLED(A)	((A)->signalled == 1)
-#define CLEAR_SIGNAL(A)	(A)->signalled = 0
+/*
+ * A duration txn is over once the strand's deadline has passed. The
+ * strands see that between operations on their own; a signal is only
+ * sent to those that fail to get back to the barrier in time.
+ */
+#define	DEADLINE_PASSED(A)	((A)->deadline != 0 &&			\
+	GETHRTIME() >= (A)->deadline)
+#define SIGNALLED(A)	((A)->signalled == 1 || DEADLINE_PASSED(A))
+#define CLEAR_SIGNAL(A)	(A)->signalled = 0, (A)->deadline = 0
+/*
+ * The peer resets the connection if it ends its side of a duration
+ * txn with data of ours unread. Like a hangup, that ends ours too.
+ */
+#define	PEER_RESET(A)	((A)->deadline != 0 &&				\
+	(errno == ECONNRESET || errno == EPIPE))
+
 
+/* Buckets of the connection table to begin with */
+#define	STRAND_CTABLE_MIN	64
 
-#define	STRAND_CONNECTION_CACHE_SIZE	8
+/* CPU bitmaps of the strands, for up to 1024 CPUs */
+#define	STRAND_CPU_WORDS	16
+#define	STRAND_MAX_CPUS		(STRAND_CPU_WORDS * 64)
+#define	STRAND_CPU_SET(m, c)	((m)[(c) / 64] |= 1ULL << ((c) % 64))
+#define	STRAND_CPU_ISSET(m, c)	(((m)[(c) / 64] >> ((c) % 64)) & 1)
 
 struct uperf_strand {
 	/*
@@ -56,9 +78,12 @@ struct uperf_strand {
 	int 		no_connections1;
 	protocol_t 	**connections1;
 	protocol_t	*listen_conn[NUM_PROTOCOLS];
-	protocol_t	*ccache[STRAND_CONNECTION_CACHE_SIZE];
-	int		ccache_size;
-	protocol_t	*cpool;
+	protocol_t	**ctable;	/* Connections hashed by id */
+	int		ctable_size;	/* Buckets, a power of 2 */
+	int		nconnections;
+	protocol_t	*cpool;		/* All of them, newest first */
+	uint32_t	shards;		/* SO_REUSEPORT listeners it owns */
+	uint64_t	accepts;	/* Connections accepted */
 
 	/*
 	 * List of slaves this strand connects to. This is used to keep 
@@ -69,11 +94,23 @@ struct uperf_strand {
 	pid_t		pid;
 	pthread_t	tid;	/* actual thread id */
 	int 		role;
+	int		sid;	/* Index of the strand in its group */
 	volatile uint32_t	strand_flag;
 	volatile uint32_t	signalled;
+	hrtime_t	deadline;	/* End of the current duration txn */
+	hrtime_t	measure_start;	/* Stats window of the current txn */
+	hrtime_t	measure_end;	/* (0: no window, record everything) */
 	volatile strand_state_t	strand_state;
 	group_t		*worklist;
-	char 		*buffer;
+	char 		*buffer;	/* Current buffer of the pool */
+	int		bufsize;
+	bufpool_t	pool;
+	char		*appbuf;	/* The application's copy, touch=copy */
+	uint64_t	touch_time;	/* Spent touching data, see touch.c */
+	uint64_t	touch_sum;	/* Keeps the touching from being elided */
+	rng_t		rng;	/* Sizes and think times */
+	uint64_t	bound[STRAND_CPU_WORDS];	/* CPUs it may run on */
+	uint64_t	ran_on[STRAND_CPU_WORDS];	/* CPUs it was seen on */
 #ifdef USE_CPC
 	hwcounter_t 	hw;
 #endif
@@ -34,9 +34,168 @@
 #include <pthread.h>
 #include <stdlib.h>
 #include <stdio.h>
-#include "sync.h"
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif /* HAVE_POLL_H */
+#ifdef HAVE_LINUX_FUTEX_H
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif /* HAVE_LINUX_FUTEX_H */
 #include "uperf.h"
+#include "sync.h"
+
+#ifdef USE_FUTEX_BARRIER
+#ifdef STRAND_THREAD_ONLY
+#define	BARRIER_FUTEX_WAIT	FUTEX_WAIT_PRIVATE
+#define	BARRIER_FUTEX_WAKE	FUTEX_WAKE_PRIVATE
+#else
+/* Strands may be processes sharing the barrier through shm */
+#define	BARRIER_FUTEX_WAIT	FUTEX_WAIT
+#define	BARRIER_FUTEX_WAKE	FUTEX_WAKE
+#endif /* STRAND_THREAD_ONLY */
+
+static int
+futex_wait(atomic_uint *addr, unsigned int val, const struct timespec *ts)
+{
+	return (syscall(SYS_futex, addr, BARRIER_FUTEX_WAIT, val, ts, NULL, 0));
+}
+
+static int
+futex_wake(atomic_uint *addr, int n)
+{
+	return (syscall(SYS_futex, addr, BARRIER_FUTEX_WAKE, n, NULL, NULL, 0));
+}
 
+int
+init_barrier(barrier_t *bar, int threshold)
+{
+	int i;
+
+	atomic_init(&bar->count, 0);
+	atomic_init(&bar->gen, 0);
+	for (i = 0; i < BARRIER_LANES; i++) {
+		atomic_init(&bar->lane[i], 0);
+		atomic_init(&bar->woken[i], 0);
+	}
+	atomic_init(&bar->first, UINT64_MAX);
+	atomic_init(&bar->last, 0);
+	bar->limit = threshold;
+
+	return (0);
+}
+
+/*
+ * Wake the waiters of lane n and, below it, the first lanes that have
+ * somebody awake to carry the release on. A lane nobody sleeps on is
+ * skipped over, as nobody from it would wake its children.
+ */
+static void
+release_lanes(barrier_t *bar, int n)
+{
+	while (n < BARRIER_LANES) {
+		if (futex_wake(&bar->lane[n], INT_MAX) > 0)
+			return;
+		release_lanes(bar, 2 * n + 2);
+		n = 2 * n + 1;
+	}
+}
+
+int
+unlock_barrier(barrier_t *bar)
+{
+	unsigned int gen = atomic_load(&bar->gen) + 1;
+	int i;
+
+	/* Publish the release in every lane before anybody is woken */
+	atomic_store(&bar->gen, gen);
+	for (i = 0; i < BARRIER_LANES; i++)
+		atomic_store(&bar->lane[i], gen);
+	release_lanes(bar, 0);
+
+	return (0);
+}
+
+int
+barrier_notreached(barrier_t *bar)
+{
+	return (bar->limit - atomic_load(&bar->count));
+}
+
+/*
+ * Sleep until all strands have arrived, for at most timeout ms.
+ * Returns 0 once they have.
+ */
+int
+barrier_wait_reached(barrier_t *bar, int timeout)
+{
+	struct timespec ts;
+	unsigned int count;
+
+	ts.tv_sec = timeout / 1000;
+	ts.tv_nsec = (timeout % 1000) * 1000000L;
+	count = atomic_load(&bar->count);
+	if (count < bar->limit)
+		(void) futex_wait(&bar->count, count, &ts);
+
+	return (barrier_notreached(bar));
+}
+
+static void
+barrier_mark(barrier_t *bar)
+{
+	uint64_t now = GETHRTIME();
+	uint64_t v;
+
+	v = atomic_load(&bar->first);
+	while (now < v && !atomic_compare_exchange_weak(&bar->first, &v, now))
+		;
+	v = atomic_load(&bar->last);
+	while (now > v && !atomic_compare_exchange_weak(&bar->last, &v, now))
+		;
+}
+
+/* Time between the first and the last strand leaving the barrier */
+uint64_t
+barrier_skew(barrier_t *bar)
+{
+	uint64_t first = atomic_load(&bar->first);
+	uint64_t last = atomic_load(&bar->last);
+
+	return (last > first ? last - first : 0);
+}
+
+int
+wait_barrier(barrier_t *bar)
+{
+	unsigned int gen;
+	unsigned int n;
+	int lane;
+
+	assert(bar);
+	assert(bar->limit > 0);
+
+	/* Read the generation first, or we could miss the release */
+	gen = atomic_load(&bar->gen);
+	n = atomic_fetch_add(&bar->count, 1);
+	if (n + 1 == bar->limit)
+		(void) futex_wake(&bar->count, 1);
+	lane = n % BARRIER_LANES;
+	while (atomic_load(&bar->lane[lane]) == gen)
+		(void) futex_wait(&bar->lane[lane], gen, NULL);
+	gen = atomic_load(&bar->lane[lane]);
+	/* The first one out passes the release on down the tree */
+	if (atomic_exchange(&bar->woken[lane], gen) != gen) {
+		release_lanes(bar, 2 * lane + 1);
+		release_lanes(bar, 2 * lane + 2);
+	}
+	barrier_mark(bar);
+
+	return (0);
+}
+#else
 int
 init_barrier(barrier_t *bar, int threshold)
 {
@@ -88,6 +247,22 @@ barrier_notreached(barrier_t *bar)
 {
 	return (bar->limit - bar->count);
 }
+
+int
+barrier_wait_reached(barrier_t *bar, int timeout)
+{
+	if (barrier_notreached(bar))
+		(void) poll(NULL, 0, timeout);
+
+	return (barrier_notreached(bar));
+}
+
+/* ARGSUSED */
+uint64_t
+barrier_skew(barrier_t *bar)
+{
+	return (0);
+}
 int
 wait_barrier(barrier_t *bar)
 {
@@ -115,3 +290,4 @@ wait_barrier(barrier_t *bar)
 
 	return (-1);
 }
+#endif /* USE_FUTEX_BARRIER */
@@ -27,10 +27,36 @@
 #include <stdatomic.h>
 #endif /* HAVE_STDATOMIC_H */
 #include <pthread.h>
+#ifdef HAVE_STDINT_H
+#include <stdint.h>
+#endif /* HAVE_STDINT_H */
 
 #define	BARRIER_REACHED(a)		!barrier_notreached((a))
 #define	BARRIER_NOTREACHED(a)		barrier_notreached((a))
 
+#if defined(HAVE_LINUX_FUTEX_H) && defined(HAVE_STDATOMIC_H)
+#define	USE_FUTEX_BARRIER
+#define	BARRIER_LANES	64	/* Futex words waiters are spread over */
+
+/*
+ * Futex barrier. Strands sleep on one of BARRIER_LANES words, picked
+ * by their arrival order. The release bumps the generation in every
+ * lane and wakes lane 0; the first strand out of lane n wakes lanes
+ * 2n + 1 and 2n + 2, so thousands of strands are released by a tree
+ * of wakers rather than by one.
+ */
+typedef	struct sync_barrier {
+	atomic_uint count;		/* Strands arrived */
+	atomic_uint gen;		/* Bumped by every release */
+	atomic_uint lane[BARRIER_LANES];	/* gen, as waited on */
+	atomic_uint woken[BARRIER_LANES];	/* gen lane was woken for */
+	_Atomic uint64_t first;		/* First strand out */
+	_Atomic uint64_t last;		/* Last strand out */
+	volatile unsigned int limit;
+	int group;
+	int txn;
+} barrier_t;
+#else
 /* Barrier obj with cond var and mutex lock */
 typedef	struct sync_barrier {
 	pthread_rwlockattr_t rwattr;
@@ -48,12 +74,15 @@ typedef	struct sync_barrier {
 	int group;
 	int txn;
 } barrier_t;
+#endif /* HAVE_LINUX_FUTEX_H && HAVE_STDATOMIC_H */
 
 int init_barrier(barrier_t *, int);
 int wait_barrier(barrier_t *);
 barrier_t * get_barrier(int, int);
 int cancel_barrier(barrier_t *);
 int barrier_notreached(barrier_t *);
+int barrier_wait_reached(barrier_t *, int);
+uint64_t barrier_skew(barrier_t *);
 int unlock_barrier(barrier_t *);
 
 #endif /* _SYNC_H */
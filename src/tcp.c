@@ -46,6 +46,7 @@
 #define	USE_POLL_ACCEPT	1
 #define	LISTENQ		10240	/* 2nd argument to listen() */
 #define	TCP_TIMEOUT	1200000	/* Argument to poll */
+#define	TCP_DEFER_SECS	10	/* Wait for data this long, defer_accept */
 #define	SOCK_PORT(sin)	((sin).sin_port)
 
 /* returns the port number */
@@ -65,6 +66,25 @@ protocol_tcp_listen(protocol_t *p, void *options)
 		}
 	}
 	set_tcp_options(p->fd, flowop_options);
+	if ((flowop_options != NULL) && FO_DEFER_ACCEPT(flowop_options)) {
+#ifdef TCP_DEFER_ACCEPT
+		int secs = TCP_DEFER_SECS;
+
+		/* Connections are only accepted once they have data */
+		if (setsockopt(p->fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &secs,
+		    sizeof (secs)) < 0) {
+			(void) snprintf(msg, 128,
+			    "tcp: Cannot set TCP_DEFER_ACCEPT");
+			uperf_log_msg(UPERF_LOG_ERROR, errno, msg);
+			return (UPERF_FAILURE);
+		}
+#else
+		(void) snprintf(msg, 128,
+		    "tcp: TCP_DEFER_ACCEPT not supported");
+		uperf_log_msg(UPERF_LOG_ERROR, 0, msg);
+		return (UPERF_FAILURE);
+#endif
+	}
 
 	return (generic_listen(p, IPPROTO_TCP, options));
 }
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2008 Sun Microsystems
+ *
+ * This file is part of uperf.
+ *
+ * uperf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3
+ * as published by the Free Software Foundation.
+ *
+ * uperf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with uperf.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/*
+ * Data touching (touch=). By default uperf never looks at the bytes it
+ * moves, while a real application reads what it receives and produces
+ * what it sends. With touch= a flowop has the strand touch the payload
+ * after it is received or before it is sent:
+ *
+ *	scan		read every byte
+ *	copy		copy it from/to a buffer of the application's own
+ *	checksum	compute its Internet checksum (RFC 1071)
+ *
+ * The time it takes goes to strand->touch_time, and from there to the
+ * flowop's stats, so that it can be told apart from the time spent in
+ * the syscalls. The loops work a word at a time with independent
+ * accumulators, which lets the compiler vectorize them.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif /* HAVE_STRING_H */
+#include <strings.h>
+#include <arpa/inet.h>
+
+#include "uperf.h"
+#include "logging.h"
+#include "workorder.h"
+#include "stats.h"
+#include "strand.h"
+#include "touch.h"
+
+#define	WORD_ALIGNED(p)	(((uintptr_t)(p) & (sizeof (uint64_t) - 1)) == 0)
+
+/* Read every byte of buf */
+static uint64_t
+touch_scan(const char *buf, size_t len)
+{
+	const uint64_t *w;
+	uint64_t a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+	size_t n, i;
+
+	while (len > 0 && !WORD_ALIGNED(buf)) {
+		a0 += (uint8_t)*buf++;
+		len--;
+	}
+	w = (const uint64_t *)buf;
+	n = len / sizeof (uint64_t);
+	for (i = 0; i + 4 <= n; i += 4) {
+		a0 ^= w[i];
+		a1 ^= w[i + 1];
+		a2 ^= w[i + 2];
+		a3 ^= w[i + 3];
+	}
+	for (; i < n; i++)
+		a0 ^= w[i];
+	for (i = n * sizeof (uint64_t); i < len; i++)
+		a1 += (uint8_t)buf[i];
+
+	return (a0 ^ a1 ^ a2 ^ a3);
+}
+
+/* Fold a ones' complement sum into 16 bits */
+static uint64_t
+fold16(uint64_t sum)
+{
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+
+	return (sum);
+}
+
+/*
+ * Internet checksum of buf. The aligned middle is summed 32 bits at a
+ * time in host order into 64 bit accumulators; the sum does not depend
+ * on the byte order but for a swap at the end (RFC 1071 2.B). The
+ * bytes at either end are added in network order.
+ */
+static uint64_t
+touch_checksum(const char *buf, size_t len)
+{
+	const uint32_t *w;
+	uint64_t a0 = 0, a1 = 0;
+	uint64_t edge = 0;
+	size_t n, i;
+	int odd = 0;
+
+	while (len > 0 && ((uintptr_t)buf & (sizeof (uint32_t) - 1)) != 0) {
+		edge += odd ? (uint8_t)*buf : (uint8_t)*buf << 8;
+		odd = !odd;
+		buf++;
+		len--;
+	}
+	w = (const uint32_t *)buf;
+	n = len / sizeof (uint32_t);
+	for (i = 0; i + 2 <= n; i += 2) {
+		a0 += w[i];
+		a1 += w[i + 1];
+	}
+	for (; i < n; i++)
+		a0 += w[i];
+	a0 = ntohs((uint16_t)fold16(a0 + a1));
+	if (odd)
+		a0 = ((a0 & 0xff) << 8) | (a0 >> 8);
+	for (i = n * sizeof (uint32_t); i < len; i++, odd = !odd)
+		edge += odd ? (uint8_t)buf[i] : (uint8_t)buf[i] << 8;
+
+	return (~fold16(a0 + edge) & 0xffff);
+}
+
+/*
+ * Touch the len bytes at buf the way touch (TOUCH_*) says, before they
+ * are sent if send is set and after they were received otherwise.
+ */
+int
+touch_data(strand_t *s, int touch, char *buf, size_t len, int send)
+{
+	hrtime_t start;
+
+	if (touch == TOUCH_NONE || len == 0)
+		return (UPERF_SUCCESS);
+	if (touch == TOUCH_COPY && s->appbuf == NULL) {
+		if ((s->appbuf = calloc(1, s->bufsize)) == NULL) {
+			uperf_error("Cannot allocate %d bytes to copy to\n",
+			    s->bufsize);
+			return (UPERF_FAILURE);
+		}
+	}
+	len = MIN(len, s->bufsize);
+	start = GETHRTIME();
+	switch (touch) {
+	case TOUCH_SCAN:
+		s->touch_sum += touch_scan(buf, len);
+		break;
+	case TOUCH_COPY:
+		if (send)
+			(void) memcpy(buf, s->appbuf, len);
+		else
+			(void) memcpy(s->appbuf, buf, len);
+		break;
+	case TOUCH_CHECKSUM:
+		s->touch_sum += touch_checksum(buf, len);
+		break;
+	}
+	s->touch_time += GETHRTIME() - start;
+
+	return (UPERF_SUCCESS);
+}
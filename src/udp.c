@@ -79,12 +79,14 @@ set_udp_options(int fd, flowop_options_t *f)
 			CLEAR_FO_NONBLOCKING(f);
 		}
 	}
+	set_busy_poll_options(fd, f);
 
 	return (0);
 }
 
 static int
-read_one(int fd, char *buffer, int len, struct sockaddr_storage *from)
+read_one(int fd, char *buffer, int len, struct sockaddr_storage *from,
+    int flags)
 {
 	int ret;
 	struct msghdr msg;
@@ -106,7 +108,7 @@ read_one(int fd, char *buffer, int len, struct sockaddr_storage *from)
 	msg.msg_controllen = 0;
 	msg.msg_flags = 0;
 
-	ret = recvmsg(fd, &msg, 0);
+	ret = recvmsg(fd, &msg, flags);
 	if (ret <= 0) {
 		if (errno != EWOULDBLOCK)
 			uperf_log_msg(UPERF_LOG_ERROR, errno, "recvmsg:");
@@ -117,7 +119,7 @@ read_one(int fd, char *buffer, int len, struct sockaddr_storage *from)
 }
 
 static int
-write_one(int fd, char *buffer, int len, struct sockaddr *to)
+write_one(int fd, char *buffer, int len, struct sockaddr *to, int flags)
 {
 	socklen_t length;
 	struct msghdr msg;
@@ -145,17 +147,36 @@ write_one(int fd, char *buffer, int len, struct sockaddr *to)
 	msg.msg_controllen = 0;
 	msg.msg_flags = 0;
 
-	return (sendmsg(fd, &msg, 0));
+	return (sendmsg(fd, &msg, flags));
 }
 
+/*
+ * The flags of a read with option sink: Linux then returns the size
+ * of the datagram without copying any of it. Elsewhere it is read.
+ */
+#if defined(__linux__) && defined(MSG_TRUNC)
+#define	UDP_SINK(fo)	(FO_SINK(fo) ? MSG_TRUNC : 0)
+#else
+#define	UDP_SINK(fo)	0
+#endif
+
+/*
+ * A timed read or write is a single syscall: the timeout is either
+ * enforced by the kernel through SO_RCVTIMEO/SO_SNDTIMEO, or, on a
+ * non-blocking socket, polled for only after the syscall returned
+ * EWOULDBLOCK. In a duration txn the kernel gives up after a slice,
+ * so the deadline can be checked (generic_deadline_flags()).
+ */
 static int
 protocol_udp_read(protocol_t *p, void *buffer, int n, void *options)
 {
 	udp_private_data *pd = (udp_private_data *) p->_protocol_p;
 	int ret;
-	int nleft;
 	int total = 0;
 	int timeout = 0;
+	int flags = 0;
+	int sink = 0;
+	hrtime_t start = 0;
 	uint64_t i;
 	uint64_t repeat = 1;
 	flowop_options_t *fo = (flowop_options_t *)options;
@@ -163,44 +184,42 @@ protocol_udp_read(protocol_t *p, void *buffer, int n, void *options)
 	if (fo != NULL) {
 		timeout = (int) fo->poll_timeout/1.0e+6;
 		repeat = fo->repeat;
+		/* Only learn the size of the datagram, copy none of it */
+		sink = UDP_SINK(fo);
 	}
-	/* HACK: Force timeout for UDP */
-	/* if (timeout == 0) */
-		/* timeout = UDP_TIMEOUT; */
-
-	for (i = 0; i < repeat; i++) {
-		nleft = n;
-		if (fo && FO_NONBLOCKING(fo)) {
-			/*
-			 * First try to read, if EWOULDBLOCK, then
-			 * poll for fo->timeout seconds
-			 */
-			ret = read_one(pd->sock, buffer, n, &pd->addr_info);
-			/* Lets fallback to poll/read */
-			if ((ret <= 0) && (errno != EWOULDBLOCK)) {
-				uperf_log_msg(UPERF_LOG_ERROR, errno,
-				    "non-block write");
-				return (ret);
-			}
-			nleft = n - ret;
-			if (ret > 0)
-				total += ret;
+	if (p->deadline != 0) {
+		flags = generic_deadline_flags(p, pd->sock, SO_RCVTIMEO,
+		    timeout > 0 ? fo->poll_timeout : 0);
+		start = GETHRTIME();
+	} else if (generic_set_timeout(p, pd->sock, SO_RCVTIMEO,
+	    timeout > 0 ? fo->poll_timeout : 0) != 0 && timeout > 0) {
+		/* No kernel timeout; poll first like we used to */
+		p->syscalls++;
+		if (generic_poll(pd->sock, timeout, POLLIN) <= 0)
+			return (-1);
+	}
+
+	for (i = 0; i < repeat; ) {
+		p->syscalls++;
+		ret = read_one(pd->sock, buffer, sink ? 0 : n, &pd->addr_info,
+		    flags | sink);
+		if (ret < 0 && p->deadline != 0 && errno == EWOULDBLOCK) {
+			if (generic_deadline_wait(p, pd->sock, start,
+			    timeout > 0 ? fo->poll_timeout : 0, POLLIN,
+			    flags) != 0)
+				return (-1);
+			continue;
 		}
-		if ((nleft > 0) && (timeout > 0)) {
-			ret = generic_poll(pd->sock, timeout, POLLIN);
-			if (ret <= 0)
-				return (-1); /* ret == 0 means timeout (error); */
-			ret = read_one(pd->sock, buffer, nleft, &pd->addr_info);
-			if (ret < 0)
-				return (ret);
-			total += ret;
-		} else if ((nleft > 0) && (timeout <= 0)) {
-			/* Vanilla read */
-			ret = read_one(pd->sock, buffer, nleft, &pd->addr_info);
-			if (ret < 0)
-				return (ret);
-			total += ret;
+		if (ret < 0 && timeout > 0 && errno == EWOULDBLOCK) {
+			if (generic_timeout_wait(p, pd->sock, timeout,
+			    POLLIN) != 0)
+				return (-1);
+			continue;
 		}
+		if (ret < 0)
+			return (ret);
+		total += ret;
+		i++;
 	}
 
 	return (total);
@@ -215,9 +234,10 @@ protocol_udp_write(protocol_t *p, void *buffer, int n, void *options)
 {
 	udp_private_data *pd = (udp_private_data *) p->_protocol_p;
 	int ret;
-	size_t nleft;
 	int total = 0;
 	int timeout = 0;
+	int flags = 0;
+	hrtime_t start = 0;
 	uint64_t i;
 	uint64_t repeat = 1;
 	flowop_options_t *fo = (flowop_options_t *)options;
@@ -226,44 +246,38 @@ protocol_udp_write(protocol_t *p, void *buffer, int n, void *options)
 		timeout = (int) fo->poll_timeout/1.0e+6;
 		repeat = fo->repeat;
 	}
+	if (p->deadline != 0) {
+		flags = generic_deadline_flags(p, pd->sock, SO_SNDTIMEO,
+		    timeout > 0 ? fo->poll_timeout : 0);
+		start = GETHRTIME();
+	} else if (generic_set_timeout(p, pd->sock, SO_SNDTIMEO,
+	    timeout > 0 ? fo->poll_timeout : 0) != 0 && timeout > 0) {
+		p->syscalls++;
+		if (generic_poll(pd->sock, timeout, POLLOUT) <= 0)
+			return (-1);
+	}
 
-	for (i = 0; i < repeat; i++) {
-		nleft = n;
-
-		if (fo && FO_NONBLOCKING(fo)) {
-			/*
-			 * First try to write, if EWOULDBLOCK, then
-			 * poll for fo->timeout seconds
-			 */
-			ret = write_one(pd->sock, buffer, n,
-					(struct sockaddr *)&pd->addr_info);
-			if ((ret <= 0) && (errno != EWOULDBLOCK)) {
-				uperf_log_msg(UPERF_LOG_ERROR, errno,
-				    "non-block write");
+	for (i = 0; i < repeat; ) {
+		p->syscalls++;
+		ret = write_one(pd->sock, buffer, n,
+		    (struct sockaddr *)&pd->addr_info, flags);
+		if (ret < 0 && p->deadline != 0 && errno == EWOULDBLOCK) {
+			if (generic_deadline_wait(p, pd->sock, start,
+			    timeout > 0 ? fo->poll_timeout : 0, POLLOUT,
+			    flags) != 0)
 				return (-1);
-			} else if (ret > 0) {
-				nleft = n - ret;
-				total += ret;
-			}
+			continue;
 		}
-
-		if ((nleft > 0) && (timeout > 0)) {
-			ret = generic_poll(pd->sock, timeout, POLLOUT);
-			if (ret <= 0)
+		if (ret < 0 && timeout > 0 && errno == EWOULDBLOCK) {
+			if (generic_timeout_wait(p, pd->sock, timeout,
+			    POLLOUT) != 0)
 				return (-1);
-			ret = write_one(pd->sock, buffer, nleft,
-					(struct sockaddr *)&pd->addr_info);
-			if (ret < 0)
-				return (ret);
-			total += ret;
-		} else if ((nleft > 0) && (timeout <= 0)) {
-			/* Vanilla write */
-			ret = write_one(pd->sock, buffer, nleft,
-				(struct sockaddr *)&pd->addr_info);
-			if (ret < 0)
-				return (ret);
-			total += ret;
+			continue;
 		}
+		if (ret < 0)
+			return (ret);
+		total += ret;
+		i++;
 	}
 
 	return (total);
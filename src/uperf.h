@@ -19,7 +19,7 @@
 #define		_UPERF_H
 
 /* Keep the data version as 0.2.5 to avoid the version mismatch problem. */
-#define UPERF_DATA_VERSION	"0.3.1"
+#define UPERF_DATA_VERSION	"0.3.3"
 #define	UPERF_VERSION 		"1.0.8"
 #define	UPERF_VERSION_LEN 	16
 #define	UPERF_EMAIL_ALIAS	"uperf-discuss@lists.sourceforge.net"
@@ -33,6 +33,7 @@
 
 #define UPERF_SUCCESS 		0
 #define UPERF_FAILURE 		-1
+#define	UPERF_EXIT_REGRESSION	2	/* Exit code if a baseline regressed */
 #define	UPERF_DURATION_EXPIRED	4
 
 #define	UPERF_CANFAIL		-100
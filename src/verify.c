@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2008 Sun Microsystems
+ *
+ * This file is part of uperf.
+ *
+ * uperf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3
+ * as published by the Free Software Foundation.
+ *
+ * uperf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with uperf.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/*
+ * Payload verification (verify). Writes fill their payload with a
+ * pattern that depends only on where each byte sits, and reads check
+ * what they got against it, so that data corrupted anywhere between
+ * the two ends (NIC offloads, zerocopy, kTLS...) fails the run instead
+ * of passing for throughput. Where a byte sits is
+ *
+ *	- its offset in the connection's byte stream for TCP and the
+ *	  other stream protocols,
+ *	- its offset in the datagram for UDP and RDS,
+ *	- the message id and its offset in the message for framed
+ *	  flowops.
+ *
+ * The pattern is made of 64 bit words, each a hash of its index and
+ * the message id, stored little endian so that hosts of either byte
+ * order agree on it. Both filling and checking run a word at a time
+ * with no dependency between the words, which the compiler vectorizes;
+ * checking against the regenerated pattern is cheaper than computing a
+ * CRC of the payload and also tells where the damage is.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif /* HAVE_STRING_H */
+
+#include "uperf.h"
+#include "logging.h"
+#include "protocol.h"
+#include "workorder.h"
+#include "verify.h"
+
+#define	VERIFY_SEED	0x75706572662d7631ULL	/* "uperf-v1" */
+
+/* The k-th word of the pattern of message key */
+static inline uint64_t
+pattern_word(uint64_t key, uint64_t k)
+{
+	uint64_t x = (k + VERIFY_SEED) ^ (key << 40);
+
+	x *= 0x9e3779b97f4a7c15ULL;
+	x ^= x >> 29;
+
+	return (x);
+}
+
+static inline uint8_t
+pattern_byte(uint64_t key, uint64_t off)
+{
+	return ((uint8_t)(pattern_word(key, off / 8) >> (off % 8 * 8)));
+}
+
+static inline void
+put_le64(char *p, uint64_t v)
+{
+	int i;
+
+	for (i = 0; i < 8; i++)
+		p[i] = (char)(v >> (i * 8));
+}
+
+static inline uint64_t
+get_le64(const char *p)
+{
+	uint64_t v = 0;
+	int i;
+
+	for (i = 0; i < 8; i++)
+		v |= (uint64_t)(uint8_t)p[i] << (i * 8);
+
+	return (v);
+}
+
+/* Fill len bytes at buf with the pattern of key from offset off on */
+static void
+verify_fill(char *buf, size_t len, uint64_t key, uint64_t off)
+{
+	size_t i = 0;
+
+	for (; i < len && (off + i) % 8 != 0; i++)
+		buf[i] = pattern_byte(key, off + i);
+	for (; i + 8 <= len; i += 8)
+		put_le64(buf + i, pattern_word(key, (off + i) / 8));
+	for (; i < len; i++)
+		buf[i] = pattern_byte(key, off + i);
+}
+
+/*
+ * Check len bytes at buf against the pattern of key from offset off
+ * on. Returns the index of the first wrong byte, or len.
+ */
+static size_t
+verify_check(const char *buf, size_t len, uint64_t key, uint64_t off)
+{
+	size_t i = 0;
+
+	for (; i < len && (off + i) % 8 != 0; i++)
+		if ((uint8_t)buf[i] != pattern_byte(key, off + i))
+			return (i);
+	for (; i + 8 <= len; i += 8)
+		if (get_le64(buf + i) != pattern_word(key, (off + i) / 8))
+			break;
+	for (; i < len; i++)
+		if ((uint8_t)buf[i] != pattern_byte(key, off + i))
+			return (i);
+
+	return (len);
+}
+
+/*
+ * Fill (send) or check the len bytes of payload at buf of flowop f.
+ * id is the message id of a framed flowop. Returns 0, or -1 with errno
+ * set to EBADMSG if the data is corrupt.
+ */
+int
+verify_data(flowop_t *f, char *buf, size_t len, uint32_t id, int send)
+{
+	protocol_t *p = f->connection;
+	int datagram = (p->type == PROTOCOL_UDP || p->type == PROTOCOL_RDS);
+	uint64_t key = 0;
+	uint64_t off = 0;
+	char msg[1024];
+	size_t bad;
+
+	if (FO_FRAMED(&f->options))
+		key = (uint64_t)id + 1;
+	else if (!datagram)
+		off = send ? p->verify_tx : p->verify_rx;
+	if (send) {
+		verify_fill(buf, len, key, off);
+		if (key == 0 && !datagram)
+			p->verify_tx += len;
+		return (0);
+	}
+	if ((bad = verify_check(buf, len, key, off)) == len) {
+		if (key == 0 && !datagram)
+			p->verify_rx += len;
+		return (0);
+	}
+
+	if (key != 0)
+		(void) snprintf(msg, sizeof (msg), "flowop %s: corrupt data "
+		    "from %s:%d (connection %d), message %u byte %lu: "
+		    "0x%02x instead of 0x%02x", f->name, p->host, p->port,
+		    p->p_id, id, (unsigned long)bad, (uint8_t)buf[bad],
+		    pattern_byte(key, bad));
+	else
+		(void) snprintf(msg, sizeof (msg), "flowop %s: corrupt data "
+		    "from %s:%d (connection %d), %s byte %llu: "
+		    "0x%02x instead of 0x%02x", f->name, p->host, p->port,
+		    p->p_id, datagram ? "datagram" : "stream",
+		    (unsigned long long)(off + bad), (uint8_t)buf[bad],
+		    pattern_byte(key, off + bad));
+	uperf_log_msg(UPERF_LOG_ERROR, 0, msg);
+	errno = EBADMSG;
+
+	return (-1);
+}
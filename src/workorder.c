@@ -28,6 +28,7 @@
 #include "uperf.h"
 #include "flowops.h"
 #include "workorder.h"
+#include "flowops_library.h"
 
 #define	UPERF_STOP_TXN		"Stop Transaction"
 #define	UPERF_TXN_MASTER	"Txn End"
@@ -95,6 +96,90 @@ workorder_max_txn(workorder_t *w)
 
 	return (no);
 }
+/*
+ * The measured part of txn txnid of g, as offsets from its start:
+ * the group's warmup and cooldown are cut off duration txns. Returns
+ * 0 if all of the txn is measured.
+ */
+int
+group_txn_window(group_t *g, int txnid, uint64_t *from, uint64_t *to)
+{
+	txn_t *t;
+
+	for (t = g->tlist; t; t = t->next)
+		if (t->txnid == txnid)
+			break;
+	if (t == NULL || t->duration == 0 ||
+	    (g->warmup == 0 && g->cooldown == 0))
+		return (0);
+	*from = MIN(g->warmup, t->duration);
+	*to = MAX(*from, t->duration - MIN(g->cooldown, t->duration));
+
+	return (1);
+}
+
+/* Time g spends in warmups and cooldowns */
+uint64_t
+group_unmeasured(group_t *g)
+{
+	uint64_t from, to;
+	uint64_t sum = 0;
+	txn_t *t;
+
+	for (t = g->tlist; t; t = t->next)
+		if (group_txn_window(g, t->txnid, &from, &to))
+			sum += from + t->duration - to;
+
+	return (sum);
+}
+
+/*
+ * The measured part of txn txnid across all groups: from the first
+ * group out of its warmup to the last one into its cooldown. Returns
+ * 0 if some group measures all of the txn.
+ */
+int
+workorder_txn_window(workorder_t *w, int txnid, uint64_t *from,
+    uint64_t *to)
+{
+	uint64_t f, t;
+	int found = 0;
+	int i;
+
+	for (i = 0; i < w->ngrp; i++) {
+		if (txnid >= w->grp[i].ntxn)
+			continue;
+		if (group_txn_window(&w->grp[i], txnid, &f, &t) == 0)
+			return (0);
+		*from = found ? MIN(*from, f) : f;
+		*to = found ? MAX(*to, t) : t;
+		found = 1;
+	}
+
+	return (found);
+}
+
+/*
+ * Time the run as a whole spends in warmups and cooldowns. Each group
+ * measures its own windows (group_unmeasured()), and the run measures
+ * for as long as the group that measures longest, just like the slaves
+ * (one per group) do between them.
+ */
+uint64_t
+workorder_unmeasured(workorder_t *w)
+{
+	uint64_t sum;
+	uint64_t min = 0;
+	int i;
+
+	for (i = 0; i < w->ngrp; i++) {
+		sum = group_unmeasured(&w->grp[i]);
+		min = (i == 0) ? sum : MIN(min, sum);
+	}
+
+	return (min);
+}
+
 int
 group_max_open_connections(group_t *g)
 {
@@ -114,6 +199,8 @@ group_max_open_connections(group_t *g)
 		}
 		count = MAX(count, local_count);
 	}
+	if (g->max_async > 0)
+		count *= g->max_async;	/* nconns */
 	return (count);
 }
 
@@ -139,8 +226,16 @@ group_max_dto_size(group_t *g)
 
 	for (t = g->tlist; t; t = t->next) {
 		for (f = t->flist; f; f = f->next) {
-			if (f->options.size > count)
-				count = f->options.size;
+			int size = MAX(f->options.size, f->options.rand_sz_max);
+
+			/* The size of a compute is not I/O */
+			if (f->type == FLOWOP_COMPUTE)
+				continue;
+
+			if (FO_FRAMED(&f->options))
+				size += sizeof (frame_hdr_t);
+			if (size > count)
+				count = size;
 		}
 	}
 
@@ -223,6 +318,9 @@ optimize_txn_for_slave(txn_t *txn)
 	flowop_t *f;
 
 	for (f = txn->flist; f; f = f->next) {
+		/* A framed read always reads one message */
+		if (FO_FRAMED(&f->options))
+			continue;
 		if (f->options.rsize > f->options.size) {
 			flowop_options_t *o = &f->options;
 			if (o->count > 1) {
@@ -281,12 +379,18 @@ group_bitswap(group_t *grp)
 	grp->nthreads = BSWAP_32(grp->nthreads);
 	/* No Need to swap ntxn; already done in rx_workorder */
 	grp->max_async = BSWAP_32(grp->max_async);
+	grp->warmup = BSWAP_64(grp->warmup);
+	grp->cooldown = BSWAP_64(grp->cooldown);
+	grp->placement = BSWAP_32(grp->placement);
+	grp->nbuffers = BSWAP_32(grp->nbuffers);
+	grp->hugepages = BSWAP_32(grp->hugepages);
 	for (txn = grp->tlist; txn; txn = txn->next) {
 		/* No need to swap nflowop; already done */
 		txn->iter = BSWAP_64(txn->iter);
 		txn->txnid = BSWAP_32(txn->txnid);
 		txn->duration = BSWAP_64(txn->duration);
 		txn->rate_count = BSWAP_32(txn->rate_count);
+		txn->pipeline = BSWAP_32(txn->pipeline);
 		for (fptr = txn->flist; fptr; fptr = fptr->next) {
 			flowop_options_t *fo = &fptr->options;
 			fo->size = BSWAP_32(fo->size);
@@ -303,6 +407,16 @@ group_bitswap(group_t *grp)
 			fo->repeat = BSWAP_64(fo->repeat);
 			fo->batch_size = BSWAP_64(fo->batch_size);
 			fo->poll_timeout = BSWAP_64(fo->poll_timeout);
+			fo->spin = BSWAP_64(fo->spin);
+			fo->busy_poll = BSWAP_32(fo->busy_poll);
+			fo->scale = BSWAP_32(fo->scale);
+			fo->touch = BSWAP_32(fo->touch);
+			fo->kernel = BSWAP_32(fo->kernel);
+			fo->wss = BSWAP_32(fo->wss);
+			fo->cost = BSWAP_64(fo->cost);
+			fo->iov = BSWAP_32(fo->iov);
+			fo->coalesce = BSWAP_32(fo->coalesce);
+			fo->backlog = BSWAP_32(fo->backlog);
 			fo->encaps_port = BSWAP_32(fo->encaps_port);
 			fo->sctp_rto_min = BSWAP_32(fo->sctp_rto_min);
 			fo->sctp_rto_max = BSWAP_32(fo->sctp_rto_max);
@@ -33,6 +33,16 @@
 #define	O_SIZE_RAND		(1 << 6)
 #define	O_SCTP_UNORDERED	(1 << 7)
 #define	O_SCTP_NODELAY		(1 << 8)
+#define	O_SSL_NO_TICKETS	(1 << 9)
+#define	O_SSL_RESUME		(1 << 10)
+#define	O_SSL_EARLY_DATA	(1 << 11)
+#define	O_PREFER_BUSY_POLL	(1 << 12)
+#define	O_FRAMED		(1 << 13)
+#define	O_REPLAY_SHARD		(1 << 14)
+#define	O_VERIFY		(1 << 15)
+#define	O_SINK			(1 << 16)
+#define	O_REUSEPORT		(1 << 17)
+#define	O_DEFER_ACCEPT		(1 << 18)
 
 #define	FO_TCP_NODELAY(fo)	((fo)->flag & O_TCP_NODELAY)
 #define	FO_CANFAIL(fo)		((fo)->flag & O_CANFAIL)
@@ -42,9 +52,39 @@
 #define	FO_RANDOM_SIZE(fo)	((fo)->flag & O_SIZE_RAND)
 #define	FO_SCTP_UNORDERED(fo)	((fo)->flag & O_SCTP_UNORDERED)
 #define	FO_SCTP_NODELAY(fo)	((fo)->flag & O_SCTP_NODELAY)
+#define	FO_SSL_NO_TICKETS(fo)	((fo)->flag & O_SSL_NO_TICKETS)
+#define	FO_SSL_RESUME(fo)	((fo)->flag & O_SSL_RESUME)
+#define	FO_SSL_EARLY_DATA(fo)	((fo)->flag & O_SSL_EARLY_DATA)
+#define	FO_PREFER_BUSY_POLL(fo)	((fo)->flag & O_PREFER_BUSY_POLL)
+#define	FO_FRAMED(fo)		((fo)->flag & O_FRAMED)
+#define	FO_REPLAY_SHARD(fo)	((fo)->flag & O_REPLAY_SHARD)
+#define	FO_VERIFY(fo)		((fo)->flag & O_VERIFY)
+#define	FO_SINK(fo)		((fo)->flag & O_SINK)
+#define	FO_REUSEPORT(fo)	((fo)->flag & O_REUSEPORT)
+#define	FO_DEFER_ACCEPT(fo)	((fo)->flag & O_DEFER_ACCEPT)
 
 #define	CLEAR_FO_NONBLOCKING(f)	((f->flag &= ~O_NONBLOCKING))
 
+/* touch=: what the application does with the data, see touch.c */
+#define	TOUCH_NONE		0
+#define	TOUCH_SCAN		1	/* Read every byte */
+#define	TOUCH_COPY		2	/* Copy it to/from its own buffer */
+#define	TOUCH_CHECKSUM		3	/* Internet checksum */
+
+/* coalesce=: how the count repetitions of a write are batched */
+#define	COALESCE_NONE		0
+#define	COALESCE_SENDMSG	1	/* Gathered into sendmsg() calls */
+#define	COALESCE_MORE		2	/* MSG_MORE on all but the last */
+#define	COALESCE_CORK		3	/* Between TCP_CORK and uncork */
+#define	FLOWOP_IOV_MAX		64	/* Segments in one call */
+
+/* kernel=: the work of a compute flowop, see compute.c */
+#define	COMPUTE_HASH		0
+#define	COMPUTE_CHASE		1
+#define	COMPUTE_SIMD		2
+#define	COMPUTE_WSS_CACHE	(64 * 1024)	/* Default wss= */
+#define	COMPUTE_WSS_MEM		(64 * 1024 * 1024)	/* kernel=chase */
+
 struct flowop_options {
 	uint32_t	size;		/* In bytes */
 	uint32_t	rand_sz_min;
@@ -60,6 +100,16 @@ struct flowop_options {
 	uint64_t	repeat;		/* Flowop-internal execute count */
 	uint64_t	batch_size;	/* SCTP/UDP sendmmsg batch size */
 	uint64_t	poll_timeout;	/* In nanoseconds */
+	uint64_t	spin;		/* Busy-poll read budget in nanoseconds */
+	uint32_t	busy_poll;	/* SO_BUSY_POLL in microseconds */
+	uint32_t	scale;		/* Replay gap scale, in 1/1000 */
+	uint32_t	touch;		/* TOUCH_* */
+	uint32_t	kernel;		/* COMPUTE_* */
+	uint32_t	wss;		/* Bytes the compute kernel works on */
+	uint64_t	cost;		/* Of the kernel here, in ps/byte */
+	uint32_t	iov;		/* Messages moved per readv/writev */
+	uint32_t	coalesce;	/* COALESCE_* */
+	uint32_t	backlog;	/* listen() backlog of an accept */
 	uint32_t	encaps_port;	/* Port used for UDP encapsulation */
 	uint32_t	bblog;	/* TCP black box logging */
 	uint32_t	sctp_rto_min;		/* Minimum SCTP RTO */
@@ -84,8 +134,7 @@ struct flowop_options {
 	char		localhost[MAXHOSTNAME]; /* Localhost info as may be required in some protocols such as RDS */
 	char		engine[20];	/*bundled engine, openssl is default*/
 	char		cipher[50];	/*cipher suite*/
-	char		method[5];	/*ssl or tls, ssl is default*/
-	char		padding[5];
+	char		method[10];	/*tls, tls1.2 or tls1.3, tls is default*/
 };
 
 typedef int (*execute_func)(strand_t *, flowop_t *);
@@ -100,6 +149,11 @@ struct flowop {
 	execute_func execute;
 	newstats_t *stats;
 	protocol_t *connection;
+	struct dist *dist;	/* Size or think time distribution */
+	struct trace *trace;	/* Trace to replay */
+	struct trace_cursor *cursor;	/* This strand's place in it */
+	struct compute *work;	/* Arena of a compute flowop */
+	int (*io)(protocol_t *, void *, int, void *); /* Bound with connection */
 	uint32_t id;
 	char name[UPERF_NAME_LEN];
 };
@@ -111,7 +165,7 @@ struct transaction {
 	uint32_t nflowop;
 	uint32_t txnid;
 	uint32_t statid1;
-	uint32_t unused;
+	uint32_t pipeline;	/* Requests kept in flight */
 	uint32_t rate_count;
 	uint32_t dummy;
 	uint64_t iter;
@@ -121,12 +175,20 @@ struct transaction {
 	flowop_t *flist;
 	int (*execute)(strand_t *, struct transaction *);
 	newstats_t *stats;
+	struct plan *plan;	/* This strand's flowops, compiled */
 	char name[UPERF_NAME_LEN];
 };
 
 #define SIZEOF_TXN_T	offsetof(txn_t, next)
 #define	TXN_ID(a) (a)->txnid
 
+#define	GROUP_CPULIST_LEN	128
+
+/* How strands are spread over the CPUs of their group */
+#define	GROUP_PLACE_ANY		0	/* Any CPU of the list */
+#define	GROUP_PLACE_RR		1	/* One CPU each, nodes in turn */
+#define	GROUP_PLACE_COMPACT	2	/* One CPU each, in list order */
+
 struct thg {
 	uint32_t endian;
 	uint32_t strand_flag;
@@ -134,6 +196,13 @@ struct thg {
 	uint32_t ntxn;
 	uint32_t max_async;
 	uint32_t groupid;
+	uint64_t warmup;		/* Unmeasured start of duration txns */
+	uint64_t cooldown;		/* Unmeasured end of duration txns */
+	uint32_t placement;		/* GROUP_PLACE_* */
+	uint32_t nbuffers;		/* I/O buffers per strand */
+	uint32_t hugepages;		/* Back them with huge pages */
+	char cpus[GROUP_CPULIST_LEN];	/* CPUs of the master's strands */
+	char slave_cpus[GROUP_CPULIST_LEN];	/* and of the slave's */
 	txn_t *tlist;			/* List of transactions */
 	protocol_t *control;		/* slave connections */
 	int protocols[NUM_PROTOCOLS];	/* Protocols used */
@@ -161,6 +230,10 @@ void group_free(group_t *);
 group_t* group_clone(group_t *);
 int group_opposite(group_t *);
 int group_bitswap(group_t *);
+int group_txn_window(group_t *, int, uint64_t *, uint64_t *);
+uint64_t group_unmeasured(group_t *);
+int workorder_txn_window(workorder_t *, int, uint64_t *, uint64_t *);
+uint64_t workorder_unmeasured(workorder_t *);
 int workorder_max_txn(workorder_t *);
 
 #endif /* _WORKORDER_H */
@@ -0,0 +1,38 @@
+#!/bin/sh
+#
+# -B round trip: the first run stores a baseline, an identical run
+# without batches finds no regression (single samples never count),
+# and a batched run against a baseline ten times faster regresses.
+#
+dir=`dirname $0`
+UPERF=${UPERF:-$dir/../src/uperf}
+out=`mktemp` || exit 1
+base=`mktemp` || exit 1
+export out
+trap 'rm -f $out $base' 0
+
+rm -f $base
+$dir/test.sh $UPERF $dir/duration.xml -B $base -b 200ms || exit 1
+if ! grep "Baseline of .* written" $out; then
+	echo "baseline.sh: no baseline written"
+	exit 1
+fi
+if ! grep "^txn2.thru" $base; then
+	echo "baseline.sh: the txn has no batches"
+	exit 1
+fi
+
+$dir/test.sh $UPERF $dir/duration.xml -B $base || exit 1
+if ! grep "^0 of .* regressed" $out; then
+	echo "baseline.sh: regressions without batches"
+	exit 1
+fi
+
+awk '$1 == "txn2.thru" { $2 *= 10; $3 = 0 } { print }' $base > $out
+cp $out $base
+$dir/test.sh $UPERF $dir/duration.xml -B $base -b 200ms
+if [ $? -ne 2 ]; then
+	echo "baseline.sh: a 10x regression was not flagged"
+	exit 1
+fi
+grep "^txn2.thru .*REGRESSED" $out || exit 1
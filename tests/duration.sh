@@ -0,0 +1,30 @@
+#!/bin/sh
+#
+# Duration txns end on time, on the master and on the slave alike, and
+# without errors: every strand stops at its own deadline instead of
+# waiting for a signal.
+#
+dir=`dirname $0`
+UPERF=${UPERF:-$dir/../src/uperf}
+out=`mktemp` || exit 1
+export out
+trap 'rm -f $out' 0
+
+for profile in duration.xml duration_plan.xml; do
+	start=`date +%s`
+	$dir/test.sh $UPERF $dir/$profile || exit 1
+	end=`date +%s`
+	if grep "Error for flowop" $out; then
+		exit 1
+	fi
+	if [ `expr $end - $start` -gt 6 ]; then
+		echo "$profile: took `expr $end - $start`s"
+		exit 1
+	fi
+	# A slave strand that had to be signalled adds a second
+	if ! awk '/^Difference/ { t = $2 + 0; bad = (t < -10 || t > 10) }
+	    END { exit bad }' $out; then
+		echo "$profile: the slave took longer than the master"
+		exit 1
+	fi
+done
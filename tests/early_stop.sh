@@ -0,0 +1,30 @@
+#!/bin/sh
+#
+# With -b and -c, a 30s txn ends as soon as its throughput is stable,
+# and the slave's strands stop along with the master's.
+#
+dir=`dirname $0`
+UPERF=${UPERF:-$dir/../src/uperf}
+out=`mktemp` || exit 1
+export out
+trap 'rm -f $out' 0
+
+start=`date +%s`
+$dir/test.sh $UPERF $dir/early_stop.xml -b 100ms -c 50 || exit 1
+end=`date +%s`
+if grep "Error for flowop" $out; then
+	exit 1
+fi
+if ! grep "ended early" $out; then
+	echo "early_stop.xml: the txn was not ended early"
+	exit 1
+fi
+if [ `expr $end - $start` -gt 15 ]; then
+	echo "early_stop.xml: took `expr $end - $start`s"
+	exit 1
+fi
+if ! awk '/^Difference/ { t = $2 + 0; bad = (t < -10 || t > 10) }
+    END { exit bad }' $out; then
+	echo "early_stop.xml: the slave took longer than the master"
+	exit 1
+fi
@@ -3,6 +3,7 @@ export host=${h:-localhost}
 export uperf=${UPERF:-$1}
 
 profile=$2
+shift 2
 csocket=
 
 if [[ "$profile" == *".vsock.xml" ]]; then
@@ -21,15 +22,25 @@ else
     echo "Starting server - $uperf -s $csocket"
     $uperf -s $csocket &
     serverpid=$!
+    # Give it time to listen
+    sleep 1
 fi
 
-echo h=$host duration=10s $uperf $csocket -m $profile >>log
-h=$host duration=10s $uperf $csocket -m $profile >> log 2>&1
-exitstatus=$?
+# Any further arguments go to the master. Its output is appended to
+# log, and also written to $out if that is set.
+echo h=$host duration=10s $uperf $csocket -m $profile "$@" >>log
+h=$host duration=10s $uperf $csocket -m $profile "$@" 2>&1 | \
+    tee ${out:-/dev/null} >> log
+exitstatus=${PIPESTATUS[0]}
 
 # kill server
 if [[ $serverpid != "" ]] ; then
    echo "Killing $serverpid"
    kill -9 $serverpid
+   # Its children exit by themselves once the master is gone
+   for i in 1 2 3 4 5 6 7 8 9 10; do
+       pgrep uperf > /dev/null || break
+       sleep 1
+   done
 fi
 exit $exitstatus